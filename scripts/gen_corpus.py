@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+"""Writes the mDNS packet corpus used by the parser benchmark and fuzzer.
+
+The packets mirror what common responders put on the wire (Apple TV,
+Chromecast, network printers, NSEC-heavy hosts, a browsing query and a few
+record types the parser does not decode), names are compressed the same
+way responders compress them.
+
+usage: gen_corpus.py <output directory>
+"""
+
+import os
+import struct
+import sys
+
+ANSWER, AUTHORITY, ADDITIONAL = 1, 2, 3
+
+
+class Message:
+    def __init__(self, response=True):
+        self.buf = bytearray(12)
+        self.offsets = {}
+        self.flags = 0x8400 if response else 0x0000
+        self.counts = [0, 0, 0, 0]
+
+    def name(self, name, prefix=0):
+        # prefix: bytes of RDATA written before the name
+        labels = [label for label in name.split('.') if label]
+        out = bytearray()
+
+        for i, label in enumerate(labels):
+            suffix = '.'.join(labels[i:]).lower()
+
+            if suffix in self.offsets:
+                return out + struct.pack('>H', 0xC000 | self.offsets[suffix])
+
+            offset = len(self.buf) + prefix + len(out)
+            if offset < 0x3FFF:
+                self.offsets[suffix] = offset
+
+            encoded = label.encode()
+            out += bytes([len(encoded)]) + encoded
+
+        return out + b'\0'
+
+    def question(self, name, rrtype=12, clazz=1):
+        self.buf += self.name(name) + struct.pack('>HH', rrtype, clazz)
+        self.counts[0] += 1
+
+    def record(self, section, name, rrtype, rdata, ttl=4500, clazz=0x8001):
+        assert section >= max(
+            [s for s in range(1, 4) if self.counts[s]], default=1)
+
+        self.buf += self.name(name) + struct.pack('>HHI', rrtype, clazz, ttl)
+        self.buf += struct.pack('>H', 0)
+        rdlength = len(self.buf) - 2
+        self.buf += rdata()
+        struct.pack_into('>H', self.buf, rdlength, len(self.buf) - rdlength - 2)
+        self.counts[section] += 1
+
+    def ptr(self, section, name, target):
+        self.record(section, name, 12, lambda: self.name(target), clazz=1)
+
+    def srv(self, section, name, port, target):
+        self.record(section, name, 33, lambda: struct.pack(
+            '>HHH', 0, 0, port) + self.name(target, prefix=6))
+
+    def txt(self, section, name, entries):
+        self.record(section, name, 16, lambda: b''.join(
+            bytes([len(e)]) + e.encode() for e in entries))
+
+    def a(self, section, name, address):
+        self.record(section, name, 1, lambda: bytes(
+            int(x) for x in address.split('.')), ttl=120)
+
+    def aaaa(self, section, name, address):
+        self.record(section, name, 28, lambda: bytes.fromhex(address),
+                    ttl=120)
+
+    def nsec(self, section, name, types):
+        def rdata():
+            bitmap = bytearray(32)
+            for t in types:
+                bitmap[t // 8] |= 0x80 >> (t % 8)
+            length = max(i for i in range(32) if bitmap[i]) + 1
+            return self.name(name) + bytes([0, length]) + bitmap[:length]
+
+        self.record(section, name, 47, rdata, ttl=120)
+
+    def raw(self, section, name, rrtype, data):
+        self.record(section, name, rrtype, lambda: data)
+
+    def bytes(self):
+        struct.pack_into('>HHHHHH', self.buf, 0, 0, self.flags, *self.counts)
+        return bytes(self.buf)
+
+
+def apple_tv():
+    m = Message()
+    for service in ['_airplay._tcp.local', '_raop._tcp.local',
+                    '_companion-link._tcp.local', '_device-info._tcp.local',
+                    '_sleep-proxy._udp.local']:
+        m.ptr(ANSWER, '_services._dns-sd._udp.local', service)
+
+    airplay = 'Living Room._airplay._tcp.local'
+    raop = 'AABBCCDDEEFF@Living Room._raop._tcp.local'
+    m.ptr(ANSWER, '_airplay._tcp.local', airplay)
+    m.srv(ANSWER, airplay, 7000, 'Living-Room.local')
+    m.txt(ANSWER, airplay, [
+        'acl=0', 'deviceid=AA:BB:CC:DD:EE:FF',
+        'features=0x4A7FDFD5,0xBC157FDE', 'flags=0x18644',
+        'model=AppleTV11,1', 'pk=4f5e2a7b9c1d0e3f',
+        'pi=2e388006-13ba-4041-9a67-25dd4a43d536', 'srcvers=670.6.2', 'vv=2'])
+    m.ptr(ANSWER, '_raop._tcp.local', raop)
+    m.srv(ANSWER, raop, 7000, 'Living-Room.local')
+    m.a(ADDITIONAL, 'Living-Room.local', '192.168.1.40')
+    m.aaaa(ADDITIONAL, 'Living-Room.local',
+           'fe80000000000000104a2bfffe3c4d5e')
+    m.nsec(ADDITIONAL, 'Living-Room.local', [1, 28])
+    m.nsec(ADDITIONAL, airplay, [16, 33])
+    return m
+
+
+def chromecast():
+    m = Message()
+    instance = 'Chromecast-7f3a9e1b2c4d5e6f._googlecast._tcp.local'
+    host = '7f3a9e1b-2c4d-5e6f-7a8b-9c0d1e2f3a4b.local'
+    m.ptr(ANSWER, '_googlecast._tcp.local', instance)
+    m.txt(ADDITIONAL, instance, [
+        'id=7f3a9e1b2c4d5e6f7a8b9c0d1e2f3a4b',
+        'cd=1A2B3C4D5E6F7A8B9C0D1E2F3A4B5C6D', 'rm=', 've=05',
+        'md=Chromecast Ultra', 'ic=/setup/icon.png', 'fn=Bedroom TV',
+        'ca=201221', 'st=0', 'bs=FA8FCA7E1A2B', 'nf=1', 'rs='])
+    m.srv(ADDITIONAL, instance, 8009, host)
+    m.a(ADDITIONAL, host, '192.168.1.52')
+    return m
+
+
+def printer():
+    m = Message()
+    services = ['_ipp._tcp.local', '_ipps._tcp.local',
+                '_pdl-datastream._tcp.local', '_printer._tcp.local',
+                '_http._tcp.local']
+    instance = 'HP LaserJet MFP M234sdw (3C4D5E).'
+
+    for service in services:
+        m.ptr(ANSWER, service, instance + service)
+
+    for service in services:
+        m.srv(ADDITIONAL, instance + service,
+              631 if 'ipp' in service else 9100, 'HP3C4D5E.local')
+        m.txt(ADDITIONAL, instance + service, [
+            'txtvers=1', 'qtotal=1', 'rp=ipp/print',
+            'ty=HP LaserJet MFP M234sdw',
+            'product=(HP LaserJet MFP M234sdw)',
+            'pdl=application/pdf,image/urf,image/pwg-raster', 'Color=F',
+            'Duplex=T', 'usb_MFG=HP', 'usb_MDL=LaserJet MFP M234sdw',
+            'UUID=564e4333-4a32-3030-3833-3c4d5e000000',
+            'URF=CP1,IS1,MT1-3-5,RS600,V1.4,W8,DM1'])
+
+    m.a(ADDITIONAL, 'HP3C4D5E.local', '192.168.1.60')
+    return m
+
+
+def nsec_heavy():
+    m = Message()
+    hosts = ['host-%02d.local' % i for i in range(12)]
+
+    for i, host in enumerate(hosts):
+        m.a(ANSWER, host, '10.0.0.%d' % (i + 1))
+
+    for host in hosts:
+        m.nsec(ADDITIONAL, host, [1, 16, 28, 33, 47])
+
+    return m
+
+
+def browse_query():
+    m = Message(response=False)
+    for service in ['_services._dns-sd._udp.local', '_http._tcp.local',
+                    '_https._tcp.local', '_ssh._tcp.local', '_ftp._tcp.local',
+                    '_airplay._tcp.local', '_googlecast._tcp.local']:
+        m.question(service)
+    return m
+
+
+def undecoded_types():
+    m = Message()
+    # HINFO, CNAME and an EDNS0 OPT pseudo record
+    m.raw(ANSWER, 'box.local', 13, bytes([3]) + b'ARM' + bytes([5]) + b'LINUX')
+    m.record(ANSWER, 'alias.local', 5, lambda: m.name('box.local'))
+    m.raw(ADDITIONAL, '', 41, bytes.fromhex('0004000e00de1a2b3c4d5e6f'))
+    return m
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+
+    out = sys.argv[1]
+    os.makedirs(out, exist_ok=True)
+
+    for name, build in [('apple_tv', apple_tv), ('chromecast', chromecast),
+                        ('printer', printer), ('nsec_heavy', nsec_heavy),
+                        ('browse_query', browse_query),
+                        ('undecoded_types', undecoded_types)]:
+        with open(os.path.join(out, name + '.bin'), 'wb') as f:
+            f.write(build().bytes())
+
+
+if __name__ == '__main__':
+    main()
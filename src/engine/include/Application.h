@@ -5,10 +5,11 @@
 #include <MdnsHelper.h>
 #include <Ping46.h>
 #include <Settings.h>
+#include <SpscRing.h>
 #include <Types.h>
 #include <array>
+#include <atomic>
 #include <imgui.h>
-#include <mutex>
 
 namespace mdns::engine {
 
@@ -25,7 +26,10 @@ private:
   void handleShortcuts() const;
   void loadAppIcon() const;
   void tryAddService(ScanCardEntry entry, bool isAdvertised);
-  void onScanDataReady(std::vector<proto::mdns_response>&& responses);
+  void onScanDataReady(proto::mdns_batch const& batch);
+  void mergeDiscoveryBatches();
+  void mergeQuestions(std::vector<QuestionCardEntry>&& questions);
+  void removeExpired(std::vector<DiscoveryBatch::Expired> const& expired);
   void renderUI();
   void sortEntries();
   static void loadTexture(GLuint* dest,
@@ -58,15 +62,19 @@ private:
 
   bool m_open_ping_view = false;
   bool m_open_question_view = false;
-  bool m_discovery_running = false;
+  std::atomic<bool> m_discovery_running = false;
+
+  // Browsing thread only, expiry notices of batches the ring rejected
+  std::vector<DiscoveryBatch::Expired> m_pending_expired;
+
+  // Filled by the browsing thread, drained by the UI thread once per frame.
+  // Everything below it is only touched by the UI thread.
+  static constexpr std::size_t discovery_queue_size = 64;
+  SpscRing<DiscoveryBatch, discovery_queue_size> m_discovery_batches;
 
   std::array<char, 128> m_search_buffer = { '\0' };
   std::vector<ScanCardEntry> m_discovered_services;
-
-  std::mutex m_filtered_services_mutex;
   std::vector<ScanCardEntry> m_filtered_services;
-
-  std::mutex m_intercepted_questions_mutex;
   std::vector<QuestionCardEntry> m_intercepted_questions;
 
   std::unique_ptr<meta::Settings> m_settings;
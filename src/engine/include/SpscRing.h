@@ -0,0 +1,82 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace mdns::engine {
+
+// Bounded queue between exactly one producer and one consumer thread, with
+// neither side ever taking a lock. A full ring rejects the new element and
+// counts it as dropped, the producer never waits for the consumer.
+template<typename T, std::size_t Capacity>
+class SpscRing
+{
+  static_assert(std::has_single_bit(Capacity),
+                "SpscRing capacity must be a power of two");
+
+public:
+  // Producer thread only
+  bool tryPush(T&& value)
+  {
+    auto const tail = m_tail.load(std::memory_order_relaxed);
+
+    if (tail - m_cached_head == Capacity) {
+      m_cached_head = m_head.load(std::memory_order_acquire);
+
+      if (tail - m_cached_head == Capacity) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    }
+
+    m_slots[tail & (Capacity - 1)] = std::move(value);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer thread only. Hands every element queued so far to fn, in
+  // order, and returns their count.
+  template<typename F>
+  std::size_t drain(F&& fn)
+  {
+    auto head = m_head.load(std::memory_order_relaxed);
+    auto const tail = m_tail.load(std::memory_order_acquire);
+    auto const count = tail - head;
+
+    for (; head != tail; ++head) {
+      fn(std::move(m_slots[head & (Capacity - 1)]));
+      m_slots[head & (Capacity - 1)] = T{};
+    }
+
+    m_head.store(head, std::memory_order_release);
+    return count;
+  }
+
+  // Any thread
+  [[nodiscard]] std::uint64_t dropped() const
+  {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  // Each index owns a cache line. The producer keeps a copy of the head
+  // next to its tail and reloads it only when the ring looks full, the
+  // consumer reads the tail once per drain.
+  static constexpr std::size_t cache_line = 64;
+
+  alignas(cache_line) std::atomic<std::size_t> m_head{ 0 };
+  alignas(cache_line) std::atomic<std::size_t> m_tail{ 0 };
+  std::size_t m_cached_head = 0;
+  alignas(cache_line) std::atomic<std::uint64_t> m_dropped{ 0 };
+
+  std::array<T, Capacity> m_slots{};
+};
+
+}
+
+#endif // SPSCRING_H
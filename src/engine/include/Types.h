@@ -1,6 +1,7 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <NameFold.h>
 #include <Proto.h>
 #include <chrono>
 #include <cstdint>
@@ -12,6 +13,7 @@ namespace mdns::engine {
 struct CardEntry
 {
   std::string name;
+  proto::mdns_name_id name_id = proto::invalid_name_id;
   std::vector<std::string> ip_addresses;
   std::uint16_t port;
   std::vector<proto::mdns_rdata> dissector_meta;
@@ -20,10 +22,11 @@ struct CardEntry
 
 struct ScanCardEntry : public CardEntry
 {
-  // Services are unique only by their name
+  // Services are unique only by their name, names are interned by the
+  // parser so comparing ids is enough
   bool operator==(const ScanCardEntry& other) const noexcept
   {
-    return name == other.name;
+    return name_id == other.name_id;
   }
 };
 
@@ -32,10 +35,33 @@ struct QuestionCardEntry : public CardEntry
   // Questions are unqiue by their source and name
   bool operator==(const QuestionCardEntry& other) const noexcept
   {
-    return name == other.name && ip_addresses[0] == other.ip_addresses[0];
+    return nameEquals(name, other.name) &&
+           ip_addresses[0] == other.ip_addresses[0];
   }
 };
 
+// Entries of one parsed batch, copied out of its arena on the browsing
+// thread and merged on the UI thread
+struct DiscoveryBatch
+{
+  struct Service
+  {
+    ScanCardEntry entry;
+    bool advertised = false;
+  };
+
+  // Record whose TTL ran out, dropped from the service that lists it
+  struct Expired
+  {
+    proto::mdns_name_id name_id = proto::invalid_name_id;
+    proto::mdns_rdata rdata;
+  };
+
+  std::vector<Service> services;
+  std::vector<QuestionCardEntry> questions;
+  std::vector<Expired> expired;
+};
+
 }
 
 #endif // TYPES_H
\ No newline at end of file
@@ -17,9 +17,13 @@
 #include <algorithm>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_opengl3.h>
+#include <bit>
+#include <chrono>
 #include <imgui.h>
 #include <memory>
+#include <ranges>
 #include <stdexcept>
+#include <utility>
 
 #include <view/Dissector.h>
 #include <view/Help.h>
@@ -47,15 +51,6 @@
 #define GL_SILENCE_DEPRECATION
 #endif
 
-static std::string
-toLower(std::string s)
-{
-  std::ranges::transform(
-    s, s.begin(), [](unsigned char c) { return std::tolower(c); });
-
-  return s;
-}
-
 mdns::engine::Application::Application(int const width,
                                        int const height,
                                        std::string const& buildInfo)
@@ -128,9 +123,40 @@ mdns::engine::Application::init()
     m_mdns_helper = std::make_unique<MdnsHelper>();
     logger::core()->info("MDNS helper initialized");
 
+    m_mdns_helper->setParseThreads(static_cast<std::size_t>(
+      std::max(0, m_settings->getSettings().parse_threads.value_or(0))));
+
+    proto::mdns_payload_budget budget;
+    if (auto const ipv4 = m_settings->getSettings().query_payload_ipv4) {
+      budget.ipv4 = static_cast<std::size_t>(std::max(0, *ipv4));
+    }
+    if (auto const ipv6 = m_settings->getSettings().query_payload_ipv6) {
+      budget.ipv6 = static_cast<std::size_t>(std::max(0, *ipv6));
+    }
+    m_mdns_helper->setPayloadBudget(budget);
+
+    auto const& settings = m_settings->getSettings();
+    proto::mdns_packet_filter filter;
+    filter.drop_queries = settings.drop_queries.value_or(false);
+    filter.drop_responses = settings.drop_responses.value_or(false);
+    filter.drop_own_queries = settings.drop_own_queries.value_or(false);
+    filter.questions_only = settings.questions_only.value_or(false);
+    if (auto const window = settings.duplicate_window_ms) {
+      filter.duplicate_window = std::chrono::milliseconds(std::max(0, *window));
+    }
+    if (settings.denied_sources) {
+      for (auto const source :
+           std::views::split(*settings.denied_sources, ',')) {
+        if (!source.empty()) {
+          filter.denied_sources.emplace_back(source.begin(), source.end());
+        }
+      }
+    }
+    m_mdns_helper->setPacketFilter(std::move(filter));
+
     m_mdns_helper->connectOnServiceDiscovered(
-      [this](std::vector<proto::mdns_response>&& responses) -> void {
-        onScanDataReady(std::move(responses));
+      [this](proto::mdns_batch const& batch) -> void {
+        onScanDataReady(batch);
       });
 
     m_mdns_helper->connectOnBrowsingStateChanged(
@@ -301,6 +327,7 @@ mdns::engine::Application::run()
     ImGui::NewFrame();
 
     handleShortcuts();
+    mergeDiscoveryBatches();
     sortEntries();
     renderUI();
 
@@ -317,17 +344,16 @@ mdns::engine::Application::run()
 void
 mdns::engine::Application::sortEntries()
 {
-  std::lock_guard<std::mutex> lock(m_filtered_services_mutex);
   m_filtered_services.clear();
 
-  auto const query = toLower(std::string(m_search_buffer.data()));
+  auto const query = std::string_view(m_search_buffer.data());
   if (query.empty()) {
     m_filtered_services = m_discovered_services;
     return;
   }
 
   for (auto const& s : m_discovered_services) {
-    if (toLower(s.name).find(query) != std::string::npos) {
+    if (nameFind(s.name, query) != std::string_view::npos) {
       m_filtered_services.push_back(s);
     }
   }
@@ -398,6 +424,17 @@ mdns::engine::Application::renderUI()
       m_show_changelog_window = true;
     }
 
+    // Packets the browser set aside instead of decoding them in full
+    auto const status =
+      fmt::format("Unknown records: {}   Filtered: {}   Duplicates: {}",
+                  m_mdns_helper->unknownRecords(),
+                  m_mdns_helper->filteredPackets(),
+                  m_mdns_helper->duplicatePackets());
+    ImGui::SameLine(ImGui::GetWindowWidth() -
+                    ImGui::CalcTextSize(status.c_str()).x -
+                    ImGui::GetStyle().ItemSpacing.x * 2.0f);
+    ImGui::TextDisabled("%s", status.c_str());
+
     ImGui::EndMainMenuBar();
   }
 
@@ -541,25 +578,18 @@ mdns::engine::Application::renderDiscoveryLayout()
   ImGui::BeginChild(
     "MainContent", ImVec2(m_open_ping_view ? -810 : 0, 0), false);
 
-  {
-    std::lock_guard<std::mutex> lock(m_filtered_services_mutex);
-
-    mdns::engine::ui::renderServiceLayout(m_filtered_services,
-                                          onPingToolClick,
-                                          onQuestionWindowOpen,
-                                          onDissectorClick,
-                                          m_browser_texture,
-                                          m_info_texture,
-                                          m_terminal_texture,
-                                          m_mdns_helper->getResolveQueries());
-  }
+  mdns::engine::ui::renderServiceLayout(m_filtered_services,
+                                        onPingToolClick,
+                                        onQuestionWindowOpen,
+                                        onDissectorClick,
+                                        m_browser_texture,
+                                        m_info_texture,
+                                        m_terminal_texture,
+                                        m_mdns_helper->getResolveQueries());
 
   ImGui::Dummy(ImVec2(0.0f, 3.0f));
 
-  {
-    std::lock_guard<std::mutex> lock(m_intercepted_questions_mutex);
-    mdns::engine::ui::renderQuestionLayout(m_intercepted_questions);
-  }
+  mdns::engine::ui::renderQuestionLayout(m_intercepted_questions);
 
   if (m_open_question_view) {
     mdns::engine::ui::pushThemedWindowStyles();
@@ -619,84 +649,142 @@ mdns::engine::Application::renderDiscoveryLayout()
   ImGui::EndGroup();
 }
 
+// Runs on the browsing thread. The batch is released once this returns, the
+// entries are copied out of it and merged by the UI thread.
 void
-mdns::engine::Application::onScanDataReady(
-  std::vector<proto::mdns_response>&& responses)
+mdns::engine::Application::onScanDataReady(proto::mdns_batch const& batch)
 {
-  for (auto& response : responses) {
+  DiscoveryBatch entries;
+
+  for (auto const& response : batch.responses) {
     const bool advertised = !response.advertized_ip_addr_str.empty();
-    const std::string& ip =
-      advertised ? response.advertized_ip_addr_str : response.ip_addr_str;
-
-    auto processEntry =
-      [&](const std::string& name,
-          uint16_t port,
-          proto::mdns_rdata const& rdata,
-          std::chrono::steady_clock::time_point const& toa) -> void {
+    const std::string ip(
+      advertised ? std::string(response.advertized_ip_addr_str)
+                 : MdnsHelper::formatAddress(response.source));
+
+    auto processEntry = [&](proto::mdns_rr const& rr) -> void {
       ScanCardEntry entry{};
       entry.ip_addresses = { ip };
-      entry.port = port ? port : response.port;
-      entry.name = name;
-      entry.time_of_arrival = toa;
-      entry.dissector_meta = { rdata };
+      entry.port = rr.port ? rr.port : response.source.port;
+      // The card is named after its key, TXT records carry their strings
+      // in the record name
+      entry.name = m_mdns_helper->names().lookup(rr.name_id);
+      entry.name_id = rr.name_id;
+      entry.time_of_arrival = response.time_of_arrival;
+      entry.dissector_meta = { rr.rdata };
 
-      tryAddService(entry, advertised);
+      // Cards outlive the batch, undecoded RDATA must not pin its receive
+      // buffer
+      if (auto* raw = std::get_if<proto::mdns_rr_unknown_ext>(
+            &entry.dissector_meta.front())) {
+        raw->detach();
+      }
+
+      entries.services.push_back({ std::move(entry), advertised });
     };
 
     for (auto const& rr : response.answer_rrs) {
-      processEntry(rr.name, rr.port, rr.rdata, response.time_of_arrival);
+      processEntry(rr);
     }
 
     for (auto const& rr : response.additional_rrs) {
-      processEntry(rr.name, rr.port, rr.rdata, response.time_of_arrival);
+      processEntry(rr);
     }
 
     for (auto const& rr : response.authority_rrs) {
-      processEntry(rr.name, rr.port, rr.rdata, response.time_of_arrival);
+      processEntry(rr);
     }
 
-    std::lock_guard<std::mutex> lock(m_intercepted_questions_mutex);
-
     for (auto const& q : response.questions_list) {
       QuestionCardEntry entry{};
       entry.ip_addresses = { ip };
       entry.name = q.name;
       entry.time_of_arrival = response.time_of_arrival;
 
-      if (auto it = std::ranges::find(m_intercepted_questions, entry);
-          it == m_intercepted_questions.end()) {
-        m_intercepted_questions.insert(m_intercepted_questions.begin(),
-                                       std::move(entry));
+      entries.questions.push_back(std::move(entry));
+    }
+  }
+
+  // Expiry notices of batches the UI could not take go out first
+  entries.expired = std::exchange(m_pending_expired, {});
 
-        if (m_intercepted_questions.size() > 15) {
-          m_intercepted_questions.pop_back();
-        }
-      }
+  for (auto const& rr : batch.expired) {
+    entries.expired.push_back({ rr.name_id, rr.rdata });
+  }
+
+  // A stalled UI drops the services and questions of whole batches, a
+  // service shows up again when its records are next refreshed. Expiry
+  // notices are kept for the next batch, a dropped one would leave its
+  // card up for good. Logged at 1, 2, 4... drops to keep the log readable.
+  if (!m_discovery_batches.tryPush(std::move(entries))) {
+    m_pending_expired = std::move(entries.expired);
+
+    if (auto const dropped = m_discovery_batches.dropped();
+        std::has_single_bit(dropped)) {
+      logger::ui()->warn(
+        "UI is not keeping up, {} discovery batches dropped", dropped);
     }
   }
+}
 
-  // Special case when at start we received only mDNS pointers and we
-  // want to immediately resolve services
-  if (!m_discovered_services.empty()) {
-    auto const anyServiceResolved = std::ranges::any_of(
-      m_discovered_services,
-      [](ScanCardEntry const& entry) -> bool { return !entry.name.empty(); });
+void
+mdns::engine::Application::mergeDiscoveryBatches()
+{
+  // Instances are resolved by the browsing thread, the UI only shows what
+  // it hears
+  m_discovery_batches.drain([this](DiscoveryBatch&& batch) -> void {
+    // Expiry notices may be held back from earlier batches, records heard
+    // in this one are newer
+    removeExpired(batch.expired);
+
+    for (auto& service : batch.services) {
+      tryAddService(std::move(service.entry), service.advertised);
+    }
 
-    if (!anyServiceResolved) {
-      m_mdns_helper->scheduleDiscoveryNow();
+    mergeQuestions(std::move(batch.questions));
+  });
+}
+
+void
+mdns::engine::Application::mergeQuestions(
+  std::vector<QuestionCardEntry>&& questions)
+{
+  for (auto& entry : questions) {
+    if (auto it = std::ranges::find(m_intercepted_questions, entry);
+        it == m_intercepted_questions.end()) {
+      m_intercepted_questions.insert(m_intercepted_questions.begin(),
+                                     std::move(entry));
+
+      if (m_intercepted_questions.size() > 15) {
+        m_intercepted_questions.pop_back();
+      }
     }
   }
 }
 
 void
-mdns::engine::Application::tryAddService(ScanCardEntry entry, bool isAdvertized)
+mdns::engine::Application::removeExpired(
+  std::vector<DiscoveryBatch::Expired> const& expired)
 {
-  if (auto const& meta = entry.dissector_meta[0];
-      std::holds_alternative<proto::mdns_rr_ptr_ext>(meta)) {
-    m_mdns_helper->addResolveQuery(
-      std::get<proto::mdns_rr_ptr_ext>(meta).target);
+  for (auto const& record : expired) {
+    auto const serviceIt = std::ranges::find(
+      m_discovered_services, record.name_id, &ScanCardEntry::name_id);
+    if (serviceIt == m_discovered_services.end()) {
+      continue;
+    }
+
+    std::erase(serviceIt->dissector_meta, record.rdata);
+
+    // A service goes away with the last of its records
+    if (serviceIt->dissector_meta.empty()) {
+      m_discovered_services.erase(serviceIt);
+    }
   }
+}
 
+void
+mdns::engine::Application::tryAddService(ScanCardEntry entry, bool isAdvertized)
+{
   auto const serviceIt = std::ranges::find(m_discovered_services, entry);
   if (serviceIt == m_discovered_services.end()) {
     m_discovered_services.insert(m_discovered_services.begin(),
@@ -102,6 +102,15 @@ mdns::engine::ui::renderDissectorWindow(
                 case proto::MDNS_RECORDTYPE_NSEC:
                   name = "NSEC";
                   break;
+                case proto::MDNS_RECORDTYPE_CNAME:
+                  name = "CNAME";
+                  break;
+                case proto::MDNS_RECORDTYPE_HINFO:
+                  name = "HINFO";
+                  break;
+                case proto::MDNS_RECORDTYPE_OPT:
+                  name = "OPT";
+                  break;
               }
 
               ImGui::Text("%s (%u)", name, t);
@@ -112,12 +121,36 @@ mdns::engine::ui::renderDissectorWindow(
             ImGui::TextDisabled("No type bitmap present");
           }
 
+          ImGui::Unindent();
+        } else if constexpr (std::is_same_v<T, proto::mdns_rr_cname_ext>) {
+          ImGui::TextColored(textColor, "CNAME record");
+          ImGui::Indent();
+          ImGui::Text("Target: %s", entry.target.c_str());
+          ImGui::Unindent();
+        } else if constexpr (std::is_same_v<T, proto::mdns_rr_hinfo_ext>) {
+          ImGui::TextColored(textColor, "HINFO record");
+          ImGui::Indent();
+          ImGui::Text("CPU: %s", entry.cpu.c_str());
+          ImGui::Text("OS:  %s", entry.os.c_str());
+          ImGui::Unindent();
+        } else if constexpr (std::is_same_v<T, proto::mdns_rr_opt_ext>) {
+          ImGui::TextColored(textColor, "OPT record");
+          ImGui::Indent();
+          ImGui::Text("UDP payload size: %u", entry.udp_payload_size);
+          ImGui::Text("Version:          %u", entry.version);
+          ImGui::Text("DNSSEC OK:        %s", entry.dnssec_ok ? "yes" : "no");
+
+          for (auto const& option : entry.options) {
+            ImGui::Text(
+              "Option %u (%zu bytes)", option.code, option.data.size());
+          }
+
           ImGui::Unindent();
         } else {
           ImGui::TextColored(textColor, "UNKNOWN record");
           ImGui::Indent();
 
-          const auto& data = entry.raw;
+          auto const data = entry.raw();
 
           if (data.empty()) {
             ImGui::TextDisabled("<empty>");
@@ -3,19 +3,50 @@
 #include <memory>
 #include <spdlog/logger.h>
 
+// Compile time floor for the MDNS_LOG_* macros, statements below it are
+// compiled out. Release builds set it to info, see src/logger/CMakeLists.txt.
+#ifndef MDNS_LOG_ACTIVE_LEVEL
+#define MDNS_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+
+// The format arguments are only evaluated when the level is enabled both at
+// compile time and on the logger at runtime
+#define MDNS_LOG(handle, level, ...)                                           \
+  do {                                                                         \
+    if constexpr (static_cast<int>(level) >= MDNS_LOG_ACTIVE_LEVEL) {          \
+      if (auto* mdns_log_handle_ = (handle);                                   \
+          mdns_log_handle_->should_log(level)) {                               \
+        mdns_log_handle_->log(level, __VA_ARGS__);                             \
+      }                                                                        \
+    }                                                                          \
+  } while (false)
+
+#define MDNS_LOG_TRACE(handle, ...)                                            \
+  MDNS_LOG(handle, spdlog::level::trace, __VA_ARGS__)
+#define MDNS_LOG_DEBUG(handle, ...)                                            \
+  MDNS_LOG(handle, spdlog::level::debug, __VA_ARGS__)
+#define MDNS_LOG_INFO(handle, ...)                                             \
+  MDNS_LOG(handle, spdlog::level::info, __VA_ARGS__)
+#define MDNS_LOG_WARN(handle, ...)                                             \
+  MDNS_LOG(handle, spdlog::level::warn, __VA_ARGS__)
+#define MDNS_LOG_ERROR(handle, ...)                                            \
+  MDNS_LOG(handle, spdlog::level::err, __VA_ARGS__)
+
 namespace logger {
 void
 init();
 void
 shutdown();
 
-std::shared_ptr<spdlog::logger>
+// Loggers live until shutdown(), the handles are non-owning so using them
+// does not touch a reference count
+spdlog::logger*
 core();
-std::shared_ptr<spdlog::logger>
+spdlog::logger*
 net();
-std::shared_ptr<spdlog::logger>
+spdlog::logger*
 mdns();
-std::shared_ptr<spdlog::logger>
+spdlog::logger*
 ui();
 
 }
@@ -47,25 +47,25 @@ shutdown()
   spdlog::shutdown();
 }
 
-std::shared_ptr<spdlog::logger>
+spdlog::logger*
 core()
 {
-  return core_logger;
+  return core_logger.get();
 }
-std::shared_ptr<spdlog::logger>
+spdlog::logger*
 net()
 {
-  return net_logger;
+  return net_logger.get();
 }
-std::shared_ptr<spdlog::logger>
+spdlog::logger*
 ui()
 {
-  return ui_logger;
+  return ui_logger.get();
 }
-std::shared_ptr<spdlog::logger>
+spdlog::logger*
 mdns()
 {
-  return mdns_logger;
+  return mdns_logger.get();
 }
 
 }
@@ -0,0 +1,51 @@
+#ifndef DUPLICATEFILTER_H
+#define DUPLICATEFILTER_H
+
+#include <Proto.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace mdns {
+
+// Remembers the datagrams of the last few moments, so a response that
+// arrives on several interfaces or is repeated by its responder is parsed
+// once. Keys are a hash of the source address and the payload, kept in a
+// fixed open-addressing table that never allocates. When all slots a key may
+// use are live, the one closest to expiring is reused. Owned by the parsing
+// thread.
+class DuplicateFilter
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr std::size_t capacity = 1024;
+  static_assert((capacity & (capacity - 1)) == 0);
+
+  // A zero window turns the filter off
+  void setWindow(std::chrono::milliseconds window);
+  [[nodiscard]] std::chrono::milliseconds window() const;
+
+  // True when the same datagram was seen from the same source within the
+  // window, otherwise it is remembered from now on
+  bool seen(proto::mdns_recv_res const& message, clock::time_point now);
+
+private:
+  static constexpr std::size_t max_probes = 8;
+
+  static std::uint64_t hash(proto::mdns_recv_res const& message);
+
+  struct Slot
+  {
+    // 0 marks a slot that was never used
+    std::uint64_t hash = 0;
+    clock::time_point expires;
+  };
+
+  std::array<Slot, capacity> slots_{};
+  std::chrono::milliseconds window_{ 0 };
+};
+
+}
+
+#endif // DUPLICATEFILTER_H
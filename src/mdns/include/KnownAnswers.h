@@ -0,0 +1,46 @@
+#ifndef KNOWNANSWERS_H
+#define KNOWNANSWERS_H
+
+#include <Proto.h>
+#include <RecordCache.h>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace mdns {
+
+// Lists the PTR records the record cache holds for the questions of a query
+// as known answers (RFC 6762 7.1), so their responders stay quiet
+class KnownAnswers
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  // A question of the query, with the datagram it went into and the offset
+  // of its name there
+  struct Question
+  {
+    std::string name;
+    proto::mdns_name_id name_id = proto::invalid_name_id;
+    std::uint16_t packet = 0;
+    std::uint16_t offset = 0;
+    std::uint16_t type = proto::MDNS_RECORDTYPE_PTR;
+  };
+
+  // Appends the cached answers to PTR questions that have more than half of
+  // their TTL left. packets holds the encoded questions, answers start in
+  // the last one and go to further packets when they do not fit max_size.
+  // Every packet from the first one with answers up to the last but one
+  // gets the TC bit (RFC 6762 7.2).
+  static void append(std::span<Question const> questions,
+                     RecordCache const& cache,
+                     clock::time_point now,
+                     std::size_t max_size,
+                     std::vector<std::vector<std::uint8_t>>& packets);
+};
+
+}
+
+#endif // KNOWNANSWERS_H
@@ -1,11 +1,21 @@
 #ifndef MDNSHELPER_H
 #define MDNSHELPER_H
 
+#include <DuplicateFilter.h>
+#include <KnownAnswers.h>
+#include <NameTable.h>
 #include <Proto.h>
+#include <QueryScheduler.h>
+#include <RecordCache.h>
+#include <Resolver.h>
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -15,57 +25,181 @@ class MdnsHelper
 {
 public:
   using sock_fd_t = int;
-  using service_dicovered_cb =
-    std::function<void(std::vector<proto::mdns_response>&&)>;
+  using service_dicovered_cb = std::function<void(proto::mdns_batch const&)>;
   using browse_en_cb = std::function<void(bool)>;
 
   MdnsHelper();
   ~MdnsHelper();
   void startBrowse();
   void stopBrowse();
+  // Any thread. Requests are coalesced and rate limited, see QueryScheduler.
   void scheduleDiscoveryNow();
   void connectOnServiceDiscovered(service_dicovered_cb cb);
   void connectOnBrowsingStateChanged(browse_en_cb cb);
-  void addResolveQuery(std::string const& query);
-  void removeResolveQuery(std::string const& query);
+  // The question set belongs to the thread that edits it, the browsing
+  // thread only copies it under a lock
+  void addResolveQuery(std::string_view query);
+  void removeResolveQuery(std::string_view query);
   [[nodiscard]] std::vector<std::string> const& getResolveQueries() const;
+  [[nodiscard]] NameTable const& names() const;
+  // Records of a type without a decoder, counted instead of logged
+  [[nodiscard]] std::uint64_t unknownRecords() const;
+  // Packets rejected by the packet filter
+  [[nodiscard]] std::uint64_t filteredPackets() const;
+  // Datagrams dropped by the duplicate window
+  [[nodiscard]] std::uint64_t duplicatePackets() const;
+  void setPacketFilter(proto::mdns_packet_filter filter);
+  // Worker threads that parse received packets while the browsing thread
+  // keeps receiving, 0 parses on the browsing thread. Applies from the next
+  // startBrowse.
+  void setParseThreads(std::size_t threads);
+  // UDP payload a query datagram may take per family, clamped to
+  // mdns_payload_budget::min_size and max_size. Applies from the next query.
+  void setPayloadBudget(proto::mdns_payload_budget budget);
+  // Source addresses are kept binary, this formats one for display
+  [[nodiscard]] static std::string formatAddress(
+    proto::mdns_endpoint const& endpoint);
+
+  void parseDiscoveryBatch(std::vector<proto::mdns_recv_res>&& messages,
+                           proto::mdns_batch& batch);
+  std::optional<proto::mdns_response_view> parseDiscoveryView(
+    proto::mdns_recv_res&& message,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+  // parseDiscoveryView followed by decodeResponse
+  std::optional<proto::mdns_response> parseDiscoveryResponse(
+    proto::mdns_recv_res&& message,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+  proto::mdns_response decodeResponse(
+    proto::mdns_response_view const& view,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+  std::optional<proto::mdns_rr> decodeRR(
+    proto::mdns_packet_view const& packet,
+    proto::mdns_rr_view const& rr,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+  static bool decodeName(proto::mdns_packet_view const& packet,
+                         std::uint16_t offset,
+                         std::pmr::string& out);
+  void buildQuery(std::vector<std::string> const& services,
+                  std::size_t budget,
+                  std::vector<std::vector<std::uint8_t>>& out) const;
+  // Packs the questions into as few datagrams of at most budget bytes as
+  // they fit, names compressed against the ones before them in the same
+  // datagram. Stores where each name went.
+  static void buildQuery(std::span<KnownAnswers::Question> questions,
+                         std::size_t budget,
+                         std::vector<std::vector<std::uint8_t>>& out);
 
 private:
   void runDiscovery(std::stop_token const& stop_token,
                     std::vector<sock_fd_t>&& sockets);
-  std::optional<proto::mdns_response> parseDiscoveryResponse(
-    proto::mdns_recv_res const& message);
 
+  void dropDuplicates(std::vector<proto::mdns_recv_res>& messages);
+  void parseMessages(std::span<proto::mdns_recv_res> messages,
+                     proto::mdns_batch& batch,
+                     proto::mdns_packet_filter const& filter);
+  std::optional<proto::mdns_response_view> parseHeaderView(
+    proto::mdns_recv_res&& message,
+    std::pmr::memory_resource* resource);
+  static void indexRecords(proto::mdns_response_view& response);
+  bool acceptPacket(proto::mdns_response_view const& view,
+                    proto::mdns_packet_filter const& filter) const;
+  proto::mdns_packet_filter const& packetFilter();
+  static std::optional<proto::mdns_endpoint> parseAddress(
+    std::string const& address);
+
+  struct NameCache;
+  static NameCache& nameCacheFor(proto::mdns_packet_view const& packet);
+
+  static bool skipName(const std::uint8_t*& ptr, const std::uint8_t* end);
   static const std::uint8_t* parseName(const std::uint8_t*& ptr,
                                        const std::uint8_t* start,
                                        const std::uint8_t* end,
-                                       std::string& out);
-  proto::mdns_rr parseRR(const std::uint8_t*& ptr,
-                         const std::uint8_t* start,
-                         const std::uint8_t* end);
+                                       std::pmr::string& out,
+                                       NameCache* cache = nullptr);
+  struct RdataDecoders;
+  proto::mdns_rr parseRR(
+    const std::uint8_t*& ptr,
+    proto::mdns_packet_view const& packet,
+    NameCache* cache = nullptr,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
   static std::uint16_t readU16(const std::uint8_t*& ptr);
   static std::uint32_t readU32(const std::uint8_t*& ptr);
-  std::vector<std::uint8_t> buildQuery(
-    std::vector<std::string> const& services) const;
-
-  static void encodeDnsName(std::vector<uint8_t>& out, std::string const& name);
+  struct QueryFamily;
+  void updateQueryPackets();
+  void packQuery(QueryFamily& family,
+                 std::size_t budget,
+                 bool questions_changed,
+                 std::chrono::steady_clock::time_point now);
+  void publishBatch(proto::mdns_batch const& batch);
+  void advanceRecordCache(std::chrono::steady_clock::time_point now);
+  void sendRefreshQueries(std::vector<RecordCache::Refresh>& refresh);
 
 private:
   struct BackendImpl;
   std::unique_ptr<BackendImpl> impl_;
+  struct ParsePipeline;
+  NameTable names_;
+  std::atomic<std::uint64_t> unknown_records_{ 0 };
+  std::unique_ptr<proto::mdns_batch> batch_;
 
   service_dicovered_cb on_service_discovered_{
-    [](std::vector<proto::mdns_response>&&) {}
+    [](proto::mdns_batch const&) {}
   };
   browse_en_cb on_browsing_state_changed_{ [](bool) {} };
 
-  std::chrono::steady_clock::time_point last_query_time_;
-  std::chrono::milliseconds query_interval_{ std::chrono::milliseconds(2500) };
+  QueryScheduler query_scheduler_;
+
+  std::atomic<std::size_t> parse_threads_{ 0 };
+  // Owned by the browsing thread, null while it parses by itself
+  std::unique_ptr<ParsePipeline> pipeline_;
 
   std::jthread browsing_thread_;
   std::atomic<bool> browsing_{ false };
   std::vector<std::string> browsing_queries_{ "_services._dns-sd._udp.local." };
+  mutable std::mutex browsing_queries_mutex_;
+  std::atomic<std::uint64_t> browsing_queries_version_{ 1 };
+
+  std::atomic<std::size_t> payload_ipv4_{ proto::mdns_payload_budget{}.ipv4 };
+  std::atomic<std::size_t> payload_ipv6_{ proto::mdns_payload_budget{}.ipv6 };
+
+  // The queries of one family, packed for its payload budget
+  struct QueryFamily
+  {
+    std::size_t budget = 0;
+    // query_names_ with where each name went
+    std::vector<KnownAnswers::Question> questions;
+    std::vector<std::vector<std::uint8_t>> encoded;
+    // Datagrams of the last query, which add the known answers, and of the
+    // last refresh query
+    std::vector<std::vector<std::uint8_t>> packets;
+    std::vector<std::vector<std::uint8_t>> refresh;
+  };
+
+  // Questions for browsing_queries_ and the resolver, and their datagrams
+  // per family. Owned by the browsing thread.
+  std::vector<KnownAnswers::Question> query_names_;
+  std::uint64_t query_packet_version_ = 0;
+  std::uint64_t query_resolver_version_ = 0;
+  QueryFamily query_ipv4_;
+  QueryFamily query_ipv6_;
+
+  // Records of the responses we received, also the known answers of our
+  // queries. Owned by the browsing thread.
+  RecordCache record_cache_;
+  Resolver resolver_{ names_, record_cache_ };
+
+  proto::mdns_packet_filter packet_filter_;
+  std::mutex packet_filter_mutex_;
+  std::atomic<std::uint64_t> packet_filter_version_{ 1 };
+  std::atomic<std::uint64_t> filtered_packets_{ 0 };
+  std::atomic<std::uint64_t> duplicate_packets_{ 0 };
+
+  // Copy of packet_filter_ owned by the parsing thread
+  proto::mdns_packet_filter active_filter_;
+  std::vector<proto::mdns_endpoint> denied_sources_;
+  DuplicateFilter duplicates_;
+  std::uint64_t active_filter_version_ = 0;
 };
 
 }
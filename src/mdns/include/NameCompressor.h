@@ -0,0 +1,39 @@
+#ifndef NAMECOMPRESSOR_H
+#define NAMECOMPRESSOR_H
+
+#include <NameFold.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mdns {
+
+// Remembers where the names of one message were written, so a later name
+// that ends in the same labels points at them instead of repeating them
+// (RFC 1035 4.1.4). Labels compare case-insensitively. clear() before
+// starting the next message.
+class NameCompressor
+{
+public:
+  // Bytes name takes when written into the message now
+  [[nodiscard]] std::size_t size(std::string_view name) const;
+  // Appends name to message, which starts with the DNS header
+  void write(std::string_view name, std::vector<std::uint8_t>& message);
+  void clear();
+
+private:
+  // Length of the labels written in front of the longest known suffix and
+  // the offset of that suffix, npos when nothing matches
+  [[nodiscard]] std::pair<std::size_t, std::uint16_t> match(
+    std::string_view name) const;
+
+  std::unordered_map<std::string, std::uint16_t, NameHash, NameEqual>
+    suffixes_;
+};
+
+}
+
+#endif // NAMECOMPRESSOR_H
@@ -0,0 +1,47 @@
+#ifndef NAMEFOLD_H
+#define NAMEFOLD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace mdns {
+
+// DNS names compare case-insensitively for ASCII letters only (RFC 4343).
+// The kernels fold 32 bytes at a time with AVX2 or 16 with SSE2 when the
+// CPU has them, and 8 bytes at a time in a general-purpose register
+// otherwise. The hash is the same on every path.
+[[nodiscard]] bool
+nameEquals(std::string_view lhs, std::string_view rhs);
+
+[[nodiscard]] std::uint64_t
+nameHash(std::string_view name);
+
+// Case-insensitive substring search, returns std::string_view::npos when
+// needle does not occur in haystack
+[[nodiscard]] std::size_t
+nameFind(std::string_view haystack, std::string_view needle);
+
+struct NameHash
+{
+  using is_transparent = void;
+
+  std::size_t operator()(std::string_view name) const
+  {
+    return static_cast<std::size_t>(nameHash(name));
+  }
+};
+
+struct NameEqual
+{
+  using is_transparent = void;
+
+  bool operator()(std::string_view lhs, std::string_view rhs) const
+  {
+    return nameEquals(lhs, rhs);
+  }
+};
+
+}
+
+#endif // NAMEFOLD_H
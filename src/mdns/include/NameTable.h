@@ -0,0 +1,40 @@
+#ifndef NAMETABLE_H
+#define NAMETABLE_H
+
+#include <NameFold.h>
+#include <Proto.h>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace mdns {
+
+// Maps every distinct DNS name to a compact id, so the parser and the service
+// store compare integers instead of strings. Id 0 is reserved for the empty
+// name. Names that differ only in ASCII case share an id, lookup() returns
+// the spelling seen first. Safe to use from the browsing and the UI thread
+// at the same time.
+class NameTable
+{
+public:
+  NameTable() = default;
+  NameTable(NameTable const&) = delete;
+  NameTable& operator=(NameTable const&) = delete;
+
+  proto::mdns_name_id intern(std::string_view name);
+  [[nodiscard]] proto::mdns_name_id find(std::string_view name) const;
+  [[nodiscard]] std::string const& lookup(proto::mdns_name_id id) const;
+  [[nodiscard]] std::size_t size() const;
+
+private:
+  mutable std::shared_mutex mutex_;
+  std::deque<std::string> names_{ std::string{} };
+  std::unordered_map<std::string_view, proto::mdns_name_id, NameHash, NameEqual>
+    ids_;
+};
+
+}
+
+#endif // NAMETABLE_H
@@ -1,8 +1,16 @@
 #ifndef PROTO_H
 #define PROTO_H
 
+#include <NameFold.h>
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <span>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -11,33 +19,105 @@ namespace mdns::proto {
 static constexpr int port = 5353;
 static constexpr int unicast_response = 0x8000U;
 static constexpr int cache_flush = 0x8000U;
+static constexpr int response_flag = 0x8000U;
+static constexpr int truncated_flag = 0x0200U;
+
+// Interned DNS name, see mdns::NameTable
+using mdns_name_id = std::uint32_t;
+static constexpr mdns_name_id invalid_name_id = 0;
+
+// Datagram bytes shared by every view decoded from them. Views keep the
+// buffer alive, so names and RDATA can be decoded long after receive.
+struct mdns_packet_view
+{
+  std::shared_ptr<std::uint8_t const[]> buffer;
+  std::size_t size = 0;
+
+  // The receive path hands out pooled buffers, this copies into a new one
+  static mdns_packet_view copy_of(const void* data, std::size_t size)
+  {
+    auto buffer = std::make_shared_for_overwrite<std::uint8_t[]>(size);
+    std::copy_n(static_cast<const std::uint8_t*>(data), size, buffer.get());
+    return { std::move(buffer), size };
+  }
+
+  const std::uint8_t* begin() const { return buffer.get(); }
+
+  const std::uint8_t* end() const { return buffer.get() + size; }
+
+  std::string_view bytes(std::size_t offset, std::size_t length) const
+  {
+    return { reinterpret_cast<const char*>(begin()) + offset, length };
+  }
+};
+
+// Source of a datagram. It stays binary until it is displayed, see
+// MdnsHelper::formatAddress.
+struct mdns_endpoint
+{
+  bool ipv6 = false;
+  // Network byte order, an IPv4 address uses the first four bytes
+  std::array<std::uint8_t, 16> address{};
+  std::uint16_t port = 0;
+  std::uint32_t scope_id = 0;
+
+  bool same_address(const mdns_endpoint& rhs) const
+  {
+    return ipv6 == rhs.ipv6 && address == rhs.address;
+  }
+
+  bool operator==(const mdns_endpoint& rhs) const = default;
+};
 
 struct mdns_recv_res
 {
-  std::string ip_addr_str;
-  std::uint16_t port;
-  std::vector<char> blob;
+  mdns_endpoint source;
+  mdns_packet_view packet;
+  // Arrival interface, 0 when the backend cannot tell
+  std::uint32_t ifindex = 0;
+  // Kernel receive time, left empty when the backend cannot tell and
+  // stamped by the parser then
+  std::chrono::steady_clock::time_point time_of_arrival;
 };
 
+// Decoded types allocate their strings and vectors from the memory resource
+// they were constructed with, see mdns_batch
 struct mdns_question
 {
-  std::string name;
+  mdns_question() = default;
+  explicit mdns_question(std::pmr::memory_resource* resource)
+    : name(resource)
+  {}
+
+  std::pmr::string name;
   uint16_t type;
   uint16_t clazz;
 };
 
 struct mdns_rr_ptr_ext
 {
-  std::string target;
+  std::pmr::string target;
+  mdns_name_id target_id = invalid_name_id;
+  // Name the pointer is published under, mdns_rr::name stays empty for PTR
+  // records
+  mdns_name_id owner_id = invalid_name_id;
+
   bool operator==(const mdns_rr_ptr_ext& rhs) const
   {
-    return target == rhs.target;
+    if (target_id != invalid_name_id && rhs.target_id != invalid_name_id) {
+      return target_id == rhs.target_id;
+    }
+
+    return nameEquals(target, rhs.target);
   }
 };
 
 struct mdns_rr_txt_ext
 {
-  std::vector<std::string> entries;
+  std::pmr::vector<std::pmr::string> entries;
+  // Name the text is published under, also mdns_rr::name_id. The decoder
+  // appends the entries to mdns_rr::name for display only.
+  mdns_name_id owner_id = invalid_name_id;
 
   bool operator==(const mdns_rr_txt_ext& rhs) const
   {
@@ -47,21 +127,29 @@ struct mdns_rr_txt_ext
 
 struct mdns_rr_srv_ext
 {
-  std::uint16_t priority;
-  std::uint16_t weight;
-  std::uint16_t port;
-  std::string target;
+  std::uint16_t priority = 0;
+  std::uint16_t weight = 0;
+  std::uint16_t port = 0;
+  std::pmr::string target;
+  mdns_name_id target_id = invalid_name_id;
 
   bool operator==(const mdns_rr_srv_ext& rhs) const
   {
-    return priority == rhs.priority && weight == rhs.weight &&
-           port == rhs.port && target == rhs.target;
+    if (priority != rhs.priority || weight != rhs.weight || port != rhs.port) {
+      return false;
+    }
+
+    if (target_id != invalid_name_id && rhs.target_id != invalid_name_id) {
+      return target_id == rhs.target_id;
+    }
+
+    return nameEquals(target, rhs.target);
   }
 };
 
 struct mdns_rr_a_ext
 {
-  std::string address;
+  std::pmr::string address;
 
   bool operator==(const mdns_rr_a_ext& rhs) const
   {
@@ -71,7 +159,7 @@ struct mdns_rr_a_ext
 
 struct mdns_rr_aaaa_ext
 {
-  std::string address;
+  std::pmr::string address;
 
   bool operator==(const mdns_rr_aaaa_ext& rhs) const
   {
@@ -81,8 +169,8 @@ struct mdns_rr_aaaa_ext
 
 struct mdns_rr_nsec_ext
 {
-  std::string next_domain;
-  std::vector<uint16_t> types;
+  std::pmr::string next_domain;
+  std::pmr::vector<uint16_t> types;
 
   bool operator==(const mdns_rr_nsec_ext& rhs) const
   {
@@ -90,13 +178,82 @@ struct mdns_rr_nsec_ext
   }
 };
 
+struct mdns_rr_cname_ext
+{
+  std::pmr::string target;
+  mdns_name_id target_id = invalid_name_id;
+
+  bool operator==(const mdns_rr_cname_ext& rhs) const
+  {
+    if (target_id != invalid_name_id && rhs.target_id != invalid_name_id) {
+      return target_id == rhs.target_id;
+    }
+
+    return nameEquals(target, rhs.target);
+  }
+};
+
+struct mdns_rr_hinfo_ext
+{
+  std::pmr::string cpu;
+  std::pmr::string os;
+
+  bool operator==(const mdns_rr_hinfo_ext& rhs) const
+  {
+    return cpu == rhs.cpu && os == rhs.os;
+  }
+};
+
+struct mdns_edns_option
+{
+  std::uint16_t code;
+  std::pmr::vector<std::uint8_t> data;
+
+  bool operator==(const mdns_edns_option& rhs) const
+  {
+    return code == rhs.code && data == rhs.data;
+  }
+};
+
+// EDNS0 pseudo record (RFC 6891), the fixed fields are carried in the class
+// and TTL of the RR
+struct mdns_rr_opt_ext
+{
+  std::uint16_t udp_payload_size;
+  std::uint8_t extended_rcode;
+  std::uint8_t version;
+  bool dnssec_ok;
+  std::pmr::vector<mdns_edns_option> options;
+
+  bool operator==(const mdns_rr_opt_ext& rhs) const
+  {
+    return udp_payload_size == rhs.udp_payload_size &&
+           extended_rcode == rhs.extended_rcode && version == rhs.version &&
+           dnssec_ok == rhs.dnssec_ok && options == rhs.options;
+  }
+};
+
+// RDATA of a type without a decoder is not copied, the record shares the
+// receive buffer and points at its RDATA inside it
 struct mdns_rr_unknown_ext
 {
-  std::vector<std::uint8_t> raw;
+  std::shared_ptr<std::uint8_t const[]> data;
+  std::uint16_t length = 0;
+
+  std::span<const std::uint8_t> raw() const { return { data.get(), length }; }
+
+  // Moves the RDATA into a buffer of its own, for records kept after the
+  // batch so they do not pin a whole receive buffer
+  void detach()
+  {
+    auto copy = std::make_shared_for_overwrite<std::uint8_t[]>(length);
+    std::ranges::copy(raw(), copy.get());
+    data = std::move(copy);
+  }
 
   bool operator==(const mdns_rr_unknown_ext& rhs) const
   {
-    return raw == rhs.raw;
+    return std::ranges::equal(raw(), rhs.raw());
   }
 };
 
@@ -106,11 +263,20 @@ using mdns_rdata = std::variant<mdns_rr_ptr_ext,
                                 mdns_rr_a_ext,
                                 mdns_rr_aaaa_ext,
                                 mdns_rr_nsec_ext,
+                                mdns_rr_cname_ext,
+                                mdns_rr_hinfo_ext,
+                                mdns_rr_opt_ext,
                                 mdns_rr_unknown_ext>;
 
 struct mdns_rr
 {
-  std::string name;
+  mdns_rr() = default;
+  explicit mdns_rr(std::pmr::memory_resource* resource)
+    : name(resource)
+  {}
+
+  std::pmr::string name;
+  mdns_name_id name_id;
   std::uint16_t type;
   std::uint16_t clazz;
   std::uint32_t ttl;
@@ -118,26 +284,140 @@ struct mdns_rr
   mdns_rdata rdata;
 };
 
+// Questions and RRs of a view are offsets into the packet, names and RDATA
+// are decoded by MdnsHelper only when a consumer asks for them
+struct mdns_question_view
+{
+  std::uint16_t name;
+  std::uint16_t type;
+  std::uint16_t clazz;
+};
+
+struct mdns_rr_view
+{
+  std::uint16_t offset;
+  std::uint16_t type;
+  std::uint16_t clazz;
+  std::uint32_t ttl;
+  std::uint16_t rdata_offset;
+  std::uint16_t rdata_length;
+};
+
+struct mdns_response_view
+{
+  mdns_response_view() = default;
+  explicit mdns_response_view(std::pmr::memory_resource* resource)
+    : answer_rrs(resource)
+    , additional_rrs(resource)
+    , authority_rrs(resource)
+    , questions_list(resource)
+  {}
+
+  std::uint16_t query_id;
+  std::uint16_t flags;
+  std::uint16_t questions;
+  std::uint16_t answers;
+  std::uint16_t authorities;
+  std::uint16_t additionals;
+  // First RR after the question section, where the RR index starts
+  std::uint16_t records_offset;
+
+  std::pmr::vector<mdns_rr_view> answer_rrs;
+  std::pmr::vector<mdns_rr_view> additional_rrs;
+  std::pmr::vector<mdns_rr_view> authority_rrs;
+  std::pmr::vector<mdns_question_view> questions_list;
+  mdns_packet_view packet;
+
+  mdns_endpoint source;
+  std::uint32_t ifindex = 0;
+  std::chrono::steady_clock::time_point time_of_arrival;
+
+  std::string_view rdata(mdns_rr_view const& rr) const
+  {
+    return packet.bytes(rr.rdata_offset, rr.rdata_length);
+  }
+};
+
 struct mdns_response
 {
+  mdns_response() = default;
+  explicit mdns_response(std::pmr::memory_resource* resource)
+    : answer_rrs(resource)
+    , additional_rrs(resource)
+    , authority_rrs(resource)
+    , questions_list(resource)
+    , advertized_ip_addr_str(resource)
+  {}
+
   std::uint16_t query_id;
   std::uint16_t flags;
   std::uint16_t questions;
 
-  std::vector<mdns_rr> answer_rrs;
-  std::vector<mdns_rr> additional_rrs;
-  std::vector<mdns_rr> authority_rrs;
-  std::vector<mdns_question> questions_list;
-  std::vector<uint8_t> packet;
+  std::pmr::vector<mdns_rr> answer_rrs;
+  std::pmr::vector<mdns_rr> additional_rrs;
+  std::pmr::vector<mdns_rr> authority_rrs;
+  std::pmr::vector<mdns_question> questions_list;
+  mdns_packet_view packet;
 
-  std::string ip_addr_str;
-  std::string advertized_ip_addr_str;
-  std::uint16_t port;
+  mdns_endpoint source;
+  std::uint32_t ifindex = 0;
+  std::pmr::string advertized_ip_addr_str;
   std::chrono::steady_clock::time_point time_of_arrival;
 
-  const uint8_t* packet_start() const { return packet.data(); }
+  const uint8_t* packet_start() const { return packet.begin(); }
 
-  const uint8_t* packet_end() const { return packet.data() + packet.size(); }
+  const uint8_t* packet_end() const { return packet.end(); }
+};
+
+// Applied once the header and question section of a packet are read. Records
+// of a rejected packet are never indexed nor decoded, questions_only skips
+// them for accepted packets as well.
+struct mdns_packet_filter
+{
+  bool drop_queries = false;
+  bool drop_responses = false;
+  // Echoes of the discovery query this host sent itself
+  bool drop_own_queries = false;
+  bool questions_only = false;
+  // IPv4 or IPv6 addresses, packets from any port of them are dropped
+  std::vector<std::string> denied_sources;
+  // Copies of a datagram from the same source within this window are
+  // counted and dropped before parsing, zero keeps every copy
+  std::chrono::milliseconds duplicate_window{ 1000 };
+};
+
+// Every response decoded in one receive cycle. Their strings and vectors live
+// in the batch arena and are released at once by clear(), after the consumer
+// has merged the batch. Consumers copy what they keep, a copy allocates from
+// the default resource again.
+struct mdns_batch
+{
+  static constexpr std::size_t initial_arena_size = 64 * 1024;
+
+  mdns_batch()
+    : arena(initial_arena.get(), initial_arena_size)
+  {}
+
+  mdns_batch(mdns_batch const&) = delete;
+  mdns_batch& operator=(mdns_batch const&) = delete;
+
+  void clear()
+  {
+    // Destroy the responses before their storage goes away, the initial
+    // buffer is reused by the next cycle
+    std::pmr::vector<mdns_response>(&arena).swap(responses);
+    expired.clear();
+    arena.release();
+  }
+
+  std::unique_ptr<std::byte[]> initial_arena{
+    std::make_unique_for_overwrite<std::byte[]>(initial_arena_size)
+  };
+  std::pmr::monotonic_buffer_resource arena;
+  std::pmr::vector<mdns_response> responses{ &arena };
+  // Cached records whose TTL ran out, see mdns::RecordCache. They are copies
+  // outside the arena.
+  std::vector<mdns_rr> expired;
 };
 
 enum mdns_record_type
@@ -145,14 +425,20 @@ enum mdns_record_type
   MDNS_RECORDTYPE_IGNORE = 0,
   // Address
   MDNS_RECORDTYPE_A = 1,
+  // Canonical name for an alias
+  MDNS_RECORDTYPE_CNAME = 5,
   // Domain Name pointer
   MDNS_RECORDTYPE_PTR = 12,
+  // Host information
+  MDNS_RECORDTYPE_HINFO = 13,
   // Arbitrary text string
   MDNS_RECORDTYPE_TXT = 16,
   // IP6 Address [Thomson]
   MDNS_RECORDTYPE_AAAA = 28,
   // Server Selection [RFC2782]
   MDNS_RECORDTYPE_SRV = 33,
+  // EDNS0 pseudo record [RFC6891]
+  MDNS_RECORDTYPE_OPT = 41,
   MDNS_RECORDTYPE_NSEC = 47,
 };
 
@@ -169,159 +455,155 @@ enum mdns_class
   MDNS_CLASS_IN = 1
 };
 
-static constexpr uint8_t mdns_multi_query[] = {
-  // Transaction ID
-  0x00,
-  0x00,
-
-  // Flags (standard query)
-  0x00,
-  0x00,
-
-  // QDCOUNT = 5 questions
-  0x00,
-  0x05,
-
-  // ANCOUNT, NSCOUNT, ARCOUNT
-  0x00,
-  0x00,
-  0x00,
-  0x00,
-  0x00,
-  0x00,
-
-  // _services._dns-sd._udp.local.
-  0x09,
-  '_',
-  's',
-  'e',
-  'r',
-  'v',
-  'i',
-  'c',
-  'e',
-  's',
-  0x07,
-  '_',
-  'd',
-  'n',
-  's',
-  '-',
-  's',
-  'd',
-  0x04,
-  '_',
-  'u',
-  'd',
-  'p',
-  0x05,
-  'l',
-  'o',
-  'c',
-  'a',
-  'l',
-  0x00,
-  0x00,
-  MDNS_RECORDTYPE_PTR,
-  0x00,
-  MDNS_CLASS_IN,
-
-  // _http._tcp.local.
-  0x05,
-  '_',
-  'h',
-  't',
-  't',
-  'p',
-  0x04,
-  '_',
-  't',
-  'c',
-  'p',
-  0x05,
-  'l',
-  'o',
-  'c',
-  'a',
-  'l',
-  0x00,
-  0x00,
-  MDNS_RECORDTYPE_PTR,
-  0x00,
-  MDNS_CLASS_IN,
-
-  // _https._tcp.local.
-  0x06,
-  '_',
-  'h',
-  't',
-  't',
-  'p',
-  's',
-  0x04,
-  '_',
-  't',
-  'c',
-  'p',
-  0x05,
-  'l',
-  'o',
-  'c',
-  'a',
-  'l',
-  0x00,
-  0x00,
-  MDNS_RECORDTYPE_PTR,
-  0x00,
-  MDNS_CLASS_IN,
-
-  // _ssh._tcp.local.
-  0x04,
-  '_',
-  's',
-  's',
-  'h',
-  0x04,
-  '_',
-  't',
-  'c',
-  'p',
-  0x05,
-  'l',
-  'o',
-  'c',
-  'a',
-  'l',
-  0x00,
-  0x00,
-  MDNS_RECORDTYPE_PTR,
-  0x00,
-  MDNS_CLASS_IN,
-
-  // _ftp._tcp.local.
-  0x04,
-  '_',
-  'f',
-  't',
-  'p',
-  0x04,
-  '_',
-  't',
-  'c',
-  'p',
-  0x05,
-  'l',
-  'o',
-  'c',
-  'a',
-  'l',
-  0x00,
-  0x00,
-  MDNS_RECORDTYPE_PTR,
-  0x00,
-  MDNS_CLASS_IN,
+// Wire format helpers shared by the compile-time default query and the
+// runtime query builder. Names are in presentation format, a trailing dot
+// is optional and empty labels are skipped.
+template<typename Fn>
+constexpr void
+mdns_for_each_label(std::string_view name, Fn&& fn)
+{
+  while (!name.empty()) {
+    auto const dot = name.find('.');
+
+    if (auto const label = name.substr(0, dot); !label.empty()) {
+      fn(label);
+    }
+
+    name.remove_prefix(dot == std::string_view::npos ? name.size() : dot + 1);
+  }
+}
+
+constexpr std::size_t
+mdns_encoded_name_size(std::string_view name)
+{
+  std::size_t size = 1;
+  mdns_for_each_label(
+    name, [&](std::string_view label) { size += label.size() + 1; });
+  return size;
+}
+
+constexpr bool
+mdns_is_encodable_name(std::string_view name)
+{
+  bool labels_fit = true;
+  mdns_for_each_label(
+    name, [&](std::string_view label) { labels_fit &= label.size() <= 63; });
+  return labels_fit && mdns_encoded_name_size(name) <= 255;
+}
+
+template<typename OutputIt>
+constexpr OutputIt
+mdns_encode_name(std::string_view name, OutputIt out)
+{
+  mdns_for_each_label(name, [&](std::string_view label) {
+    *out++ = static_cast<std::uint8_t>(label.size());
+
+    for (char const c : label) {
+      *out++ = static_cast<std::uint8_t>(c);
+    }
+  });
+
+  *out++ = 0x00;
+  return out;
+}
+
+template<typename OutputIt>
+constexpr OutputIt
+mdns_encode_u16(std::uint16_t value, OutputIt out)
+{
+  *out++ = static_cast<std::uint8_t>(value >> 8);
+  *out++ = static_cast<std::uint8_t>(value & 0xFF);
+  return out;
+}
+
+template<typename OutputIt>
+constexpr OutputIt
+mdns_encode_u32(std::uint32_t value, OutputIt out)
+{
+  out = mdns_encode_u16(static_cast<std::uint16_t>(value >> 16), out);
+  return mdns_encode_u16(static_cast<std::uint16_t>(value & 0xFFFF), out);
+}
+
+// UDP payload a query datagram may take per family, larger queries are
+// split instead of fragmented. The defaults are a 1500 byte Ethernet MTU less
+// the IPv4 and UDP headers, and the IPv6 minimum MTU of 1280 less the IPv6
+// and UDP headers.
+struct mdns_payload_budget
+{
+  static constexpr std::size_t min_size = 512;
+  // Largest mDNS message (RFC 6762, section 17)
+  static constexpr std::size_t max_size = 9000;
+
+  std::size_t ipv4 = 1472;
+  std::size_t ipv6 = 1232;
+};
+
+// Standard query with transaction id 0 and no answer, authority or
+// additional records
+template<typename OutputIt>
+constexpr OutputIt
+mdns_encode_query_header(std::uint16_t questions, OutputIt out)
+{
+  out = mdns_encode_u16(0x0000, out);
+  out = mdns_encode_u16(0x0000, out);
+  out = mdns_encode_u16(questions, out);
+  out = mdns_encode_u16(0x0000, out);
+  out = mdns_encode_u16(0x0000, out);
+  return mdns_encode_u16(0x0000, out);
+}
+
+template<typename OutputIt>
+constexpr OutputIt
+mdns_encode_question(std::string_view name,
+                     std::uint16_t type,
+                     std::uint16_t clazz,
+                     OutputIt out)
+{
+  out = mdns_encode_name(name, out);
+  out = mdns_encode_u16(type, out);
+  return mdns_encode_u16(clazz, out);
+}
+
+constexpr std::size_t
+mdns_ptr_query_size(std::span<const std::string_view> names)
+{
+  std::size_t size = sizeof(std::uint16_t) * 6;
+
+  for (auto const name : names) {
+    size += mdns_encoded_name_size(name) + sizeof(std::uint16_t) * 2;
+  }
+
+  return size;
+}
+
+template<std::size_t N>
+constexpr std::array<std::uint8_t, N>
+mdns_build_ptr_query(std::span<const std::string_view> names)
+{
+  std::array<std::uint8_t, N> packet{};
+
+  auto out = mdns_encode_query_header(
+    static_cast<std::uint16_t>(names.size()), packet.begin());
+  for (auto const name : names) {
+    out = mdns_encode_question(name, MDNS_RECORDTYPE_PTR, MDNS_CLASS_IN, out);
+  }
+
+  return packet;
+}
+
+// Sent when no resolve query is configured
+static constexpr std::string_view mdns_default_services[] = {
+  "_services._dns-sd._udp.local.",
+  "_http._tcp.local.",
+  "_https._tcp.local.",
+  "_ssh._tcp.local.",
+  "_ftp._tcp.local.",
 };
 
+static constexpr auto mdns_multi_query =
+  mdns_build_ptr_query<mdns_ptr_query_size(mdns_default_services)>(
+    mdns_default_services);
+
 }
 
 #endif // PROTO_H
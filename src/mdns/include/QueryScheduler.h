@@ -0,0 +1,70 @@
+#ifndef QUERYSCHEDULER_H
+#define QUERYSCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <random>
+
+namespace mdns {
+
+// Decides when the browsing thread sends its next query. Queries back off as
+// RFC 6762 5.2 asks: 1 s after the first, then 2 s, 4 s... up to an hour.
+// Each one is held back by a random 20-120 ms, so hosts that start together
+// do not query in lockstep.
+//
+// requestNow() and requestSoon() may be called from any thread. Every request
+// made before the next query is served by that query, which never follows
+// the previous one within the rate window. After requestNow() the backoff
+// starts over from it. A query sent early for requestSoon() leaves the
+// backoff and the query it had planned as they were.
+class QueryScheduler
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct Config
+  {
+    std::chrono::milliseconds first_interval{ 1000 };
+    std::chrono::milliseconds max_interval{ std::chrono::hours(1) };
+    std::chrono::milliseconds min_jitter{ 20 };
+    std::chrono::milliseconds max_jitter{ 120 };
+    std::chrono::milliseconds rate_window{ 1000 };
+  };
+
+  QueryScheduler();
+  explicit QueryScheduler(Config config);
+
+  // Any thread. True when no request was pending yet, the caller then
+  // wakes the browsing thread.
+  bool requestNow();
+  bool requestSoon();
+
+  // Browsing thread only. restart() schedules the first query of a new
+  // backoff, next() folds in pending requests and returns when the next
+  // query is due, sent() schedules the one after it. A query that could not
+  // go out is retried after the rate window by failed(), the backoff stays.
+  void restart(clock::time_point now);
+  clock::time_point next(clock::time_point now);
+  void sent(clock::time_point now);
+  void failed(clock::time_point now);
+
+  // Interval the query after the next one will wait
+  [[nodiscard]] std::chrono::milliseconds interval() const;
+
+private:
+  std::chrono::milliseconds jitter();
+
+  Config config_;
+  std::atomic<bool> requested_{ false };
+  std::atomic<bool> soon_{ false };
+  clock::time_point next_;
+  // Where the backoff puts the next query, next_ may be earlier
+  clock::time_point backoff_;
+  clock::time_point last_sent_;
+  std::chrono::milliseconds interval_;
+  std::minstd_rand random_;
+};
+
+}
+
+#endif // QUERYSCHEDULER_H
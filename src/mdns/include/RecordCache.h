@@ -0,0 +1,119 @@
+#ifndef RECORDCACHE_H
+#define RECORDCACHE_H
+
+#include <Proto.h>
+#include <TimerWheel.h>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace mdns {
+
+// Records received in responses, keyed by name, type, class and RDATA, each
+// with the expiry its TTL gives it. At 80, 85, 90 and 95 % of the TTL (plus
+// up to 2 % at random) a record asks to be refreshed, at 100 % it expires
+// (RFC 6762 5.2). Every record is one timer on a TimerWheel, so both cost
+// O(1) per record instead of a scan of the cache. Owned by the browsing
+// thread.
+class RecordCache
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr std::chrono::milliseconds tick{ 100 };
+  // Records beyond this are not cached until others expire
+  static constexpr std::size_t capacity = 65536;
+
+  // Question that would refresh a cached record
+  struct Refresh
+  {
+    proto::mdns_name_id name_id = proto::invalid_name_id;
+    std::uint16_t type = 0;
+  };
+
+  // Cached record with the TTL it has left
+  struct Known
+  {
+    proto::mdns_rr const* record = nullptr;
+    std::uint32_t ttl = 0;
+  };
+
+  RecordCache();
+
+  // Caches the answer and additional records of a response, or renews the
+  // cached copies. A goodbye (TTL 0) and a cache-flush record leave the
+  // records they replace one more second (RFC 6762 10.1, 10.2).
+  void insert(proto::mdns_response const& response);
+
+  // Fires what came due by now: refresh questions are appended to refresh,
+  // expired records are removed and appended to expired
+  void advance(clock::time_point now,
+               std::vector<Refresh>& refresh,
+               std::vector<proto::mdns_rr>& expired);
+
+  // A cached IN record of the set, nullptr when there is none. Valid until
+  // the next insert or advance.
+  [[nodiscard]] proto::mdns_rr const* find(proto::mdns_name_id owner,
+                                           std::uint16_t type) const;
+
+  // Appends the cached IN records of the set that have more than half of
+  // their TTL left, the known answers of a question for it (RFC 6762 7.1).
+  // Valid until the next insert or advance.
+  void knownAnswers(proto::mdns_name_id owner,
+                    std::uint16_t type,
+                    clock::time_point now,
+                    std::vector<Known>& out) const;
+
+  // advance() has nothing to do before this, max when the cache is empty
+  [[nodiscard]] clock::time_point nextEvent() const;
+  [[nodiscard]] std::size_t size() const;
+  void clear();
+
+private:
+  // Stages 0-3 refresh, the last one expires
+  static constexpr std::uint8_t expiry_stage = 4;
+
+  struct Entry
+  {
+    proto::mdns_rr record;
+    proto::mdns_name_id owner = proto::invalid_name_id;
+    std::size_t hash = 0;
+    clock::time_point received;
+    std::chrono::milliseconds lifetime{ 0 };
+    clock::time_point due;
+    std::uint8_t stage = 0;
+    bool live = false;
+  };
+
+  static proto::mdns_name_id ownerOf(proto::mdns_rr const& rr);
+  static std::size_t hashOf(proto::mdns_name_id owner,
+                            proto::mdns_rr const& rr);
+  static std::uint64_t rrsetOf(proto::mdns_name_id owner,
+                               proto::mdns_rr const& rr);
+
+  TimerWheel::timer_id lookup(proto::mdns_name_id owner,
+                              std::size_t hash,
+                              proto::mdns_rr const& rr) const;
+  void store(proto::mdns_rr const& rr, clock::time_point received);
+  void flushRrset(TimerWheel::timer_id keep, clock::time_point received);
+  void planStage(TimerWheel::timer_id id);
+  void expireAt(TimerWheel::timer_id id, clock::time_point when);
+  void remove(TimerWheel::timer_id id);
+  [[nodiscard]] TimerWheel::tick_t tickAfter(clock::time_point when) const;
+
+  std::vector<Entry> entries_;
+  std::vector<TimerWheel::timer_id> free_;
+  std::unordered_multimap<std::size_t, TimerWheel::timer_id> index_;
+  std::unordered_multimap<std::uint64_t, TimerWheel::timer_id> rrsets_;
+  TimerWheel wheel_;
+  clock::time_point epoch_;
+  std::vector<TimerWheel::timer_id> fired_;
+  std::minstd_rand random_;
+};
+
+}
+
+#endif // RECORDCACHE_H
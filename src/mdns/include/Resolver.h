@@ -0,0 +1,101 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <NameTable.h>
+#include <Proto.h>
+#include <RecordCache.h>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace mdns {
+
+// Follows every DNS-SD instance a PTR record points at through its stages:
+// SRV and TXT of the instance, then A and AAAA of the host the SRV names.
+// Each stage asks typed questions for what the cache still lacks and stops
+// once it holds the records, or after a few unanswered queries. An instance
+// given up on is not tried again within the TTL of its PTR record. Resolved
+// names are then kept fresh by the cache refresh. Service types listed by
+// the DNS-SD enumeration are browsed with PTR questions while their PTR
+// record lives. Owned by the browsing thread.
+class Resolver
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr std::uint8_t max_attempts = 4;
+  // Instances beyond this are not resolved until others go away
+  static constexpr std::size_t capacity = 4096;
+
+  struct Question
+  {
+    proto::mdns_name_id name_id = proto::invalid_name_id;
+    std::uint16_t type = 0;
+
+    bool operator==(Question const&) const = default;
+  };
+
+  // Stages are read from the records in cache
+  Resolver(NameTable& names, RecordCache const& cache);
+
+  // Takes the service types and instances the PTR records of a response
+  // point at
+  void discover(proto::mdns_response const& response);
+  // Moves instances on whose records reached the cache. True when there
+  // are questions that were not asked before.
+  bool advance();
+  // Forgets what an expired PTR record pointed at
+  void forget(proto::mdns_rr const& expired);
+  // A query with the questions went out at now, instances that were asked
+  // too often give up
+  void sent(clock::time_point now);
+  void clear();
+
+  // Changes whenever questions() does
+  [[nodiscard]] std::uint64_t version() const;
+  [[nodiscard]] std::vector<Question> const& questions() const;
+  // Whether the records of a name should be refreshed
+  [[nodiscard]] bool interested(proto::mdns_name_id name_id) const;
+  [[nodiscard]] std::size_t pending() const;
+
+private:
+  enum class Stage : std::uint8_t
+  {
+    Service,
+    Address,
+    Resolved,
+  };
+
+  struct Instance
+  {
+    Stage stage = Stage::Service;
+    proto::mdns_name_id host = proto::invalid_name_id;
+    std::uint8_t attempts = 0;
+    // Of the PTR record it was discovered by
+    std::uint32_t ttl = 0;
+  };
+
+  void drop(proto::mdns_name_id id);
+  bool rebuildQuestions();
+
+  NameTable& names_;
+  RecordCache const& cache_;
+  proto::mdns_name_id enumeration_id_;
+  std::unordered_set<proto::mdns_name_id> types_;
+  std::unordered_map<proto::mdns_name_id, Instance> instances_;
+  // Instances not resolved yet, the only ones advance() looks at
+  std::vector<proto::mdns_name_id> pending_;
+  // Resolved instances per host
+  std::unordered_map<proto::mdns_name_id, std::uint32_t> hosts_;
+  // Instances given up on, with the time their PTR records may start them
+  // over
+  std::unordered_map<proto::mdns_name_id, clock::time_point> given_up_;
+  std::vector<Question> questions_;
+  std::uint64_t version_ = 0;
+};
+
+}
+
+#endif // RESOLVER_H
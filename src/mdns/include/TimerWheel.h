@@ -0,0 +1,69 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace mdns {
+
+// Hierarchical timing wheel: four levels of 64 slots, the first one tick
+// wide, each next one 64 times coarser. Timers are ids into caller-owned
+// state, linked into their slot, so scheduling and cancelling are O(1). A
+// timer moves down a level at most three times before it fires. Deadlines
+// beyond the last level are clamped, the caller checks on firing.
+class TimerWheel
+{
+public:
+  using timer_id = std::uint32_t;
+  using tick_t = std::uint64_t;
+
+  static constexpr std::size_t levels = 4;
+  static constexpr std::size_t slots = 64;
+  static constexpr tick_t never = std::numeric_limits<tick_t>::max();
+
+  // Deadlines at or before the current tick fire on the next advance
+  void schedule(timer_id id, tick_t deadline);
+  void cancel(timer_id id);
+  [[nodiscard]] bool scheduled(timer_id id) const;
+
+  // Moves time forward to tick and appends every timer that came due
+  void advance(tick_t tick, std::vector<timer_id>& fired);
+
+  // No timer fires before this tick, never when none is scheduled
+  [[nodiscard]] tick_t nextTick() const;
+  [[nodiscard]] tick_t now() const;
+  [[nodiscard]] std::size_t size() const;
+
+private:
+  static constexpr timer_id none = std::numeric_limits<timer_id>::max();
+  static constexpr unsigned slot_bits = 6;
+  static constexpr tick_t slot_mask = slots - 1;
+
+  struct Link
+  {
+    timer_id prev = none;
+    timer_id next = none;
+    // Index into heads_, none while not scheduled
+    std::uint32_t slot = none;
+    tick_t deadline = 0;
+  };
+
+  void link(timer_id id, tick_t earliest);
+  void unlink(timer_id id);
+  void cascade(std::size_t level);
+
+  std::vector<Link> links_;
+  std::array<timer_id, levels * slots> heads_ = [] {
+    std::array<timer_id, levels * slots> heads{};
+    heads.fill(none);
+    return heads;
+  }();
+  tick_t now_ = 0;
+  std::size_t size_ = 0;
+};
+
+}
+
+#endif // TIMERWHEEL_H
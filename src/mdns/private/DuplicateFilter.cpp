@@ -0,0 +1,96 @@
+#include "DuplicateFilter.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr std::uint64_t hash_seed = 0xcbf29ce484222325ULL;
+constexpr std::uint64_t hash_multiplier = 0x9e3779b97f4a7c15ULL;
+
+std::uint64_t
+load(const std::uint8_t* data, std::size_t size)
+{
+  std::uint64_t word = 0;
+  std::memcpy(&word, data, size);
+  return word;
+}
+
+std::uint64_t
+mix(std::uint64_t hash, std::uint64_t word)
+{
+  hash = (hash ^ word) * hash_multiplier;
+  return hash ^ (hash >> 29);
+}
+
+std::uint64_t
+hashBytes(std::uint64_t hash, const std::uint8_t* data, std::size_t size)
+{
+  for (; size >= 8; data += 8, size -= 8) {
+    hash = mix(hash, load(data, 8));
+  }
+
+  if (size > 0) {
+    hash = mix(hash, load(data, size));
+  }
+
+  return hash;
+}
+
+}
+
+void
+mdns::DuplicateFilter::setWindow(std::chrono::milliseconds window)
+{
+  window_ = window;
+}
+
+std::chrono::milliseconds
+mdns::DuplicateFilter::window() const
+{
+  return window_;
+}
+
+std::uint64_t
+mdns::DuplicateFilter::hash(proto::mdns_recv_res const& message)
+{
+  // The arrival interface is left out, copies received on different
+  // interfaces are the duplicates this filter is for
+  auto const& source = message.source;
+  auto hash =
+    hashBytes(hash_seed, source.address.data(), source.address.size());
+  hash = mix(hash, (std::uint64_t{ source.ipv6 } << 16) | source.port);
+  hash = hashBytes(hash, message.packet.buffer.get(), message.packet.size);
+  hash = mix(hash, message.packet.size);
+
+  return hash == 0 ? 1 : hash;
+}
+
+bool
+mdns::DuplicateFilter::seen(proto::mdns_recv_res const& message,
+                            clock::time_point now)
+{
+  if (window_.count() <= 0) {
+    return false;
+  }
+
+  auto const key = hash(message);
+  Slot* victim = nullptr;
+
+  for (std::size_t probe = 0; probe < max_probes; ++probe) {
+    auto& slot = slots_[(key + probe) & (capacity - 1)];
+
+    if (slot.hash == key && slot.expires > now) {
+      return true;
+    }
+
+    // Unused and expired slots expire first, otherwise the entry closest to
+    // expiring makes room
+    if (victim == nullptr || slot.expires < victim->expires) {
+      victim = &slot;
+    }
+  }
+
+  victim->hash = key;
+  victim->expires = now + window_;
+  return false;
+}
@@ -0,0 +1,173 @@
+#include "KnownAnswers.h"
+#include <NameFold.h>
+#include <algorithm>
+#include <variant>
+
+namespace {
+
+constexpr std::size_t header_size = 12;
+constexpr std::size_t flags_offset = 2;
+constexpr std::size_t answers_offset = 6;
+// Type, class, TTL and RDATA length
+constexpr std::size_t rr_fixed_size = 10;
+constexpr std::uint16_t pointer_mark = 0xC000;
+
+std::string_view
+trimDot(std::string_view name)
+{
+  while (!name.empty() && name.back() == '.') {
+    name.remove_suffix(1);
+  }
+
+  return name;
+}
+
+// Length of the labels in front of owner when target lies below it,
+// otherwise npos
+std::size_t
+prefixBelow(std::string_view target, std::string_view owner)
+{
+  target = trimDot(target);
+  owner = trimDot(owner);
+
+  if (owner.empty() || target.size() <= owner.size() + 1) {
+    return std::string_view::npos;
+  }
+
+  auto const prefix = target.size() - owner.size() - 1;
+  if (target[prefix] != '.' ||
+      !mdns::nameEquals(target.substr(prefix + 1), owner)) {
+    return std::string_view::npos;
+  }
+
+  return prefix;
+}
+
+std::uint16_t
+readU16(std::vector<std::uint8_t> const& packet, std::size_t offset)
+{
+  return static_cast<std::uint16_t>((packet[offset] << 8) |
+                                    packet[offset + 1]);
+}
+
+std::uint16_t
+pointerTo(std::uint16_t offset)
+{
+  return static_cast<std::uint16_t>(pointer_mark | offset);
+}
+
+void
+writeU16(std::vector<std::uint8_t>& packet,
+         std::size_t offset,
+         std::uint16_t value)
+{
+  mdns::proto::mdns_encode_u16(value, packet.begin() + offset);
+}
+
+}
+
+void
+mdns::KnownAnswers::append(std::span<Question const> questions,
+                           RecordCache const& cache,
+                           clock::time_point now,
+                           std::size_t max_size,
+                           std::vector<std::vector<std::uint8_t>>& packets)
+{
+  if (packets.empty() || questions.empty()) {
+    return;
+  }
+
+  // Where each question's name is written in the current packet, answers
+  // point there instead of repeating it. 0 when it is not written yet.
+  std::vector<std::uint16_t> owners;
+  for (auto const& question : questions) {
+    owners.push_back(question.packet + 1u == packets.size() ? question.offset
+                                                            : 0);
+  }
+
+  bool continuation = false;
+  // Datagrams in front of it hold questions only and are complete queries
+  auto first_answered = packets.size();
+  std::vector<RecordCache::Known> known;
+
+  for (std::size_t index = 0; index < questions.size(); ++index) {
+    auto const& question = questions[index];
+    if (question.type != proto::MDNS_RECORDTYPE_PTR) {
+      continue;
+    }
+
+    known.clear();
+    cache.knownAnswers(
+      question.name_id, proto::MDNS_RECORDTYPE_PTR, now, known);
+
+    for (auto const& answer : known) {
+      auto const* ptr =
+        std::get_if<proto::mdns_rr_ptr_ext>(&answer.record->rdata);
+      if (ptr == nullptr) {
+        continue;
+      }
+
+      auto const prefix = prefixBelow(ptr->target, question.name);
+      auto const target = std::string_view(ptr->target).substr(0, prefix);
+      auto const rdata_size = prefix != std::string_view::npos
+                                ? proto::mdns_encoded_name_size(target) + 1
+                                : proto::mdns_encoded_name_size(target);
+      auto const owner_size = [&] {
+        return owners[index] != 0
+                 ? sizeof(pointer_mark)
+                 : proto::mdns_encoded_name_size(question.name);
+      };
+
+      // A fresh continuation takes the answer even if it is too large, so
+      // no packet is ever left without one
+      if (packets.back().size() + owner_size() + rr_fixed_size + rdata_size >
+            max_size &&
+          !(continuation && packets.back().size() == header_size)) {
+        packets.emplace_back(header_size, std::uint8_t{ 0 });
+        std::ranges::fill(owners, std::uint16_t{ 0 });
+        continuation = true;
+      }
+
+      auto& packet = packets.back();
+      auto out = std::back_inserter(packet);
+
+      if (owners[index] != 0) {
+        out = proto::mdns_encode_u16(pointerTo(owners[index]), out);
+      } else {
+        owners[index] = static_cast<std::uint16_t>(packet.size());
+        out = proto::mdns_encode_name(question.name, out);
+      }
+
+      out = proto::mdns_encode_u16(proto::MDNS_RECORDTYPE_PTR, out);
+      out = proto::mdns_encode_u16(proto::MDNS_CLASS_IN, out);
+      out = proto::mdns_encode_u32(answer.ttl, out);
+      out =
+        proto::mdns_encode_u16(static_cast<std::uint16_t>(rdata_size), out);
+
+      // The instance labels, then a pointer to the service name they sit
+      // under
+      if (prefix != std::string_view::npos) {
+        proto::mdns_for_each_label(target, [&](std::string_view label) {
+          *out++ = static_cast<std::uint8_t>(label.size());
+          std::ranges::copy(label, out);
+        });
+        out = proto::mdns_encode_u16(pointerTo(owners[index]), out);
+      } else {
+        out = proto::mdns_encode_name(target, out);
+      }
+
+      writeU16(packet,
+               answers_offset,
+               static_cast<std::uint16_t>(readU16(packet, answers_offset) + 1));
+      first_answered = std::min(first_answered, packets.size() - 1);
+    }
+  }
+
+  // The responders wait for the rest of the known answers before they reply
+  for (auto i = first_answered; i + 1 < packets.size(); ++i) {
+    writeU16(packets[i],
+             flags_offset,
+             static_cast<std::uint16_t>(readU16(packets[i], flags_offset) |
+                                        proto::truncated_flag));
+  }
+}
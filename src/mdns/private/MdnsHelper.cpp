@@ -2,6 +2,10 @@
 #include "../include/Proto.h"
 #include "Logger.h"
 #include "MdnsImpl.hpp"
+#include "MdnsPipeline.hpp"
+#include "NameCompressor.h"
+#include <array>
+#include <cstring>
 
 #if defined(_WIN32)
 #include <winsock2.h>
@@ -12,6 +16,7 @@
 
 mdns::MdnsHelper::MdnsHelper()
   : impl_(std::make_unique<BackendImpl>())
+  , batch_(std::make_unique<proto::mdns_batch>())
 {}
 
 mdns::MdnsHelper::~MdnsHelper() = default;
@@ -44,12 +49,22 @@ mdns::MdnsHelper::startBrowse()
 }
 
 void
-mdns::MdnsHelper::addResolveQuery(std::string const& query)
+mdns::MdnsHelper::addResolveQuery(std::string_view query)
 {
-  if (auto const it = std::ranges::find(browsing_queries_, query);
+  std::lock_guard lock(browsing_queries_mutex_);
+
+  if (auto const it = std::ranges::find_if(
+        browsing_queries_,
+        [&](std::string const& q) -> bool { return nameEquals(q, query); });
       it == browsing_queries_.end()) {
-    logger::mdns()->info("Adding question: " + query);
-    browsing_queries_.push_back(query);
+    logger::mdns()->info("Adding question: {}", query);
+    browsing_queries_.emplace_back(query);
+    browsing_queries_version_.fetch_add(1, std::memory_order_release);
+
+    // A new question starts the backoff over
+    if (query_scheduler_.requestNow()) {
+      impl_->wake();
+    }
   }
 }
 
@@ -59,13 +74,131 @@ mdns::MdnsHelper::getResolveQueries() const
   return browsing_queries_;
 }
 
+mdns::NameTable const&
+mdns::MdnsHelper::names() const
+{
+  return names_;
+}
+
+std::uint64_t
+mdns::MdnsHelper::unknownRecords() const
+{
+  return unknown_records_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t
+mdns::MdnsHelper::filteredPackets() const
+{
+  return filtered_packets_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t
+mdns::MdnsHelper::duplicatePackets() const
+{
+  return duplicate_packets_.load(std::memory_order_relaxed);
+}
+
+std::string
+mdns::MdnsHelper::formatAddress(proto::mdns_endpoint const& endpoint)
+{
+  char buffer[INET6_ADDRSTRLEN] = {};
+
+  if (!inet_ntop(endpoint.ipv6 ? AF_INET6 : AF_INET,
+                 endpoint.address.data(),
+                 buffer,
+                 sizeof(buffer))) {
+    return {};
+  }
+
+  return buffer;
+}
+
+std::optional<mdns::proto::mdns_endpoint>
+mdns::MdnsHelper::parseAddress(std::string const& address)
+{
+  proto::mdns_endpoint endpoint;
+
+  if (inet_pton(AF_INET, address.c_str(), endpoint.address.data()) == 1) {
+    return endpoint;
+  }
+
+  if (inet_pton(AF_INET6, address.c_str(), endpoint.address.data()) == 1) {
+    endpoint.ipv6 = true;
+    return endpoint;
+  }
+
+  return std::nullopt;
+}
+
+void
+mdns::MdnsHelper::setParseThreads(std::size_t threads)
+{
+  parse_threads_.store(threads, std::memory_order_relaxed);
+}
+
+void
+mdns::MdnsHelper::setPayloadBudget(proto::mdns_payload_budget budget)
+{
+  auto const clamp = [](std::size_t size) {
+    return std::clamp(size,
+                      proto::mdns_payload_budget::min_size,
+                      proto::mdns_payload_budget::max_size);
+  };
+
+  payload_ipv4_.store(clamp(budget.ipv4), std::memory_order_relaxed);
+  payload_ipv6_.store(clamp(budget.ipv6), std::memory_order_relaxed);
+}
+
+void
+mdns::MdnsHelper::setPacketFilter(proto::mdns_packet_filter filter)
+{
+  std::lock_guard lock(packet_filter_mutex_);
+  packet_filter_ = std::move(filter);
+  packet_filter_version_.fetch_add(1, std::memory_order_release);
+}
+
+mdns::proto::mdns_packet_filter const&
+mdns::MdnsHelper::packetFilter()
+{
+  // The parsing thread works on its own copy, refreshed only after
+  // setPacketFilter
+  if (auto const version =
+        packet_filter_version_.load(std::memory_order_acquire);
+      version != active_filter_version_) {
+    if (pipeline_) {
+      pipeline_->wait_idle();
+    }
+
+    std::lock_guard lock(packet_filter_mutex_);
+    active_filter_ = packet_filter_;
+    active_filter_version_ = version;
+    duplicates_.setWindow(active_filter_.duplicate_window);
+
+    denied_sources_.clear();
+    for (auto const& source : active_filter_.denied_sources) {
+      if (auto const endpoint = parseAddress(source)) {
+        denied_sources_.push_back(endpoint.value());
+      } else {
+        logger::mdns()->warn("Ignoring invalid denied source: {}", source);
+      }
+    }
+  }
+
+  return active_filter_;
+}
+
 void
-mdns::MdnsHelper::removeResolveQuery(std::string const& query)
+mdns::MdnsHelper::removeResolveQuery(std::string_view query)
 {
-  if (auto const it = std::ranges::find(browsing_queries_, query);
+  std::lock_guard lock(browsing_queries_mutex_);
+
+  if (auto const it = std::ranges::find_if(
+        browsing_queries_,
+        [&](std::string const& q) -> bool { return nameEquals(q, query); });
       it != browsing_queries_.end()) {
-    logger::mdns()->info("Removing question: " + query);
+    logger::mdns()->info("Removing question: {}", query);
     browsing_queries_.erase(it);
+    browsing_queries_version_.fetch_add(1, std::memory_order_release);
   }
 }
 
@@ -88,101 +221,385 @@ mdns::MdnsHelper::stopBrowse()
   on_browsing_state_changed_(false);
 }
 
-std::vector<std::uint8_t>
-mdns::MdnsHelper::buildQuery(std::vector<std::string> const& services) const
+void
+mdns::MdnsHelper::buildQuery(std::vector<std::string> const& services,
+                             std::size_t budget,
+                             std::vector<std::vector<std::uint8_t>>& out) const
 {
   if (services.empty()) {
     logger::mdns()->info("Service list is empty, baking generic query");
 
-    return std::vector<std::uint8_t>(std::begin(proto::mdns_multi_query),
-                                     std::end(proto::mdns_multi_query));
+    out.assign(1,
+               std::vector<std::uint8_t>(proto::mdns_multi_query.begin(),
+                                         proto::mdns_multi_query.end()));
+    return;
+  }
+
+  std::vector<KnownAnswers::Question> questions;
+
+  for (auto const& s : services) {
+    if (proto::mdns_is_encodable_name(s)) {
+      questions.push_back({ .name = s });
+    } else {
+      logger::mdns()->warn("Skipping question with invalid name: {}", s);
+    }
   }
 
-  std::vector<uint8_t> pkt;
-  pkt.push_back(0x00);
-  pkt.push_back(0x00);
-  pkt.push_back(0x00);
-  pkt.push_back(0x00);
+  buildQuery(questions, budget, out);
+}
 
-  uint16_t qdcount = services.size();
-  pkt.push_back(qdcount >> 8);
-  pkt.push_back(qdcount & 0xFF);
+void
+mdns::MdnsHelper::buildQuery(std::span<KnownAnswers::Question> questions,
+                             std::size_t budget,
+                             std::vector<std::vector<std::uint8_t>>& out)
+{
+  out.clear();
 
-  pkt.insert(pkt.end(), { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }); // AN, NS, AR
+  // Pointers only reach back into their own datagram
+  NameCompressor names;
+  std::uint16_t count = 0;
 
-  for (auto const& s : services) {
-    encodeDnsName(pkt, s);
+  for (auto& question : questions) {
+    auto const size = names.size(question.name) + sizeof(std::uint16_t) * 2;
+
+    // A question larger than the budget still goes out, alone
+    if (out.empty() || (count > 0 && out.back().size() + size > budget)) {
+      out.emplace_back();
+      proto::mdns_encode_query_header(0, std::back_inserter(out.back()));
+      names.clear();
+      count = 0;
+    }
+
+    auto& packet = out.back();
+    question.packet = static_cast<std::uint16_t>(out.size() - 1);
+    question.offset = static_cast<std::uint16_t>(packet.size());
+
+    names.write(question.name, packet);
+    proto::mdns_encode_u16(question.type, std::back_inserter(packet));
+    proto::mdns_encode_u16(proto::MDNS_CLASS_IN, std::back_inserter(packet));
+
+    // QDCOUNT follows the id and the flags
+    proto::mdns_encode_u16(++count, packet.begin() + 4);
+  }
+}
+
+void
+mdns::MdnsHelper::updateQueryPackets()
+{
+  // The questions are re-encoded only after the question set, the work of
+  // the resolver or a payload budget changed
+  bool questions_changed = false;
+
+  if (auto const version =
+        browsing_queries_version_.load(std::memory_order_acquire);
+      version != query_packet_version_ ||
+      resolver_.version() != query_resolver_version_) {
+    auto const add = [&](std::string_view name, std::uint16_t type) {
+      // Decoded names carry no trailing dot, configured ones may
+      auto const decoded =
+        name.ends_with('.') ? name.substr(0, name.size() - 1) : name;
+      auto const name_id = names_.intern(decoded);
+
+      if (std::ranges::none_of(query_names_, [&](auto const& question) {
+            return question.name_id == name_id && question.type == type;
+          })) {
+        query_names_.push_back(
+          { .name = std::string(name), .name_id = name_id, .type = type });
+      }
+    };
+
+    query_names_.clear();
+    {
+      std::lock_guard lock(browsing_queries_mutex_);
+
+      if (browsing_queries_.empty()) {
+        for (auto const name : proto::mdns_default_services) {
+          add(name, proto::MDNS_RECORDTYPE_PTR);
+        }
+      }
+
+      for (auto const& s : browsing_queries_) {
+        if (proto::mdns_is_encodable_name(s)) {
+          add(s, proto::MDNS_RECORDTYPE_PTR);
+        } else {
+          logger::mdns()->warn("Skipping question with invalid name: {}", s);
+        }
+      }
 
-    pkt.push_back(0x00);
-    pkt.push_back(proto::MDNS_RECORDTYPE_PTR);
+      query_packet_version_ = version;
+    }
+
+    for (auto const& question : resolver_.questions()) {
+      if (auto const& name = names_.lookup(question.name_id);
+          proto::mdns_is_encodable_name(name)) {
+        add(name, question.type);
+      }
+    }
+    query_resolver_version_ = resolver_.version();
+    questions_changed = true;
+  }
 
-    pkt.push_back(0x00);
-    pkt.push_back(proto::MDNS_CLASS_IN);
+  // The known answers age between queries, so the datagrams are rebuilt
+  // every time. Parse workers compare against them to drop our own queries.
+  if (pipeline_) {
+    pipeline_->wait_idle();
   }
 
-  return pkt;
+  auto const now = std::chrono::steady_clock::now();
+  packQuery(query_ipv4_,
+            payload_ipv4_.load(std::memory_order_relaxed),
+            questions_changed,
+            now);
+  packQuery(query_ipv6_,
+            payload_ipv6_.load(std::memory_order_relaxed),
+            questions_changed,
+            now);
 }
 
 void
-mdns::MdnsHelper::encodeDnsName(std::vector<uint8_t>& out,
-                                std::string const& name)
+mdns::MdnsHelper::packQuery(QueryFamily& family,
+                            std::size_t budget,
+                            bool questions_changed,
+                            std::chrono::steady_clock::time_point now)
 {
-  std::stringstream ss(name);
-  std::string label;
+  // Known answers point at the question names, buildQuery tells where it
+  // wrote them
+  if (questions_changed || family.budget != budget) {
+    family.budget = budget;
+    family.questions = query_names_;
+    buildQuery(family.questions, budget, family.encoded);
+  }
 
-  while (std::getline(ss, label, '.')) {
-    out.push_back(static_cast<uint8_t>(label.size()));
-    out.insert(out.end(), label.begin(), label.end());
+  family.packets = family.encoded;
+  KnownAnswers::append(
+    family.questions, record_cache_, now, budget, family.packets);
+}
+
+void
+mdns::MdnsHelper::publishBatch(proto::mdns_batch const& batch)
+{
+  for (auto const& response : batch.responses) {
+    record_cache_.insert(response);
+    resolver_.discover(response);
   }
 
-  out.push_back(0x00);
+  // New questions of the resolver go out soon, the rate limit groups them.
+  // The browse backoff goes on, a busy network would keep resetting it.
+  if (resolver_.advance() && query_scheduler_.requestSoon()) {
+    impl_->wake();
+  }
+
+  on_service_discovered_(batch);
+}
+
+void
+mdns::MdnsHelper::advanceRecordCache(std::chrono::steady_clock::time_point now)
+{
+  if (record_cache_.nextEvent() > now) {
+    return;
+  }
+
+  std::vector<RecordCache::Refresh> refresh;
+  record_cache_.advance(now, refresh, batch_->expired);
+
+  if (!refresh.empty()) {
+    sendRefreshQueries(refresh);
+  }
+
+  for (auto const& rr : batch_->expired) {
+    resolver_.forget(rr);
+  }
+
+  // Expired records reach the consumer like any other batch, after the
+  // records that came before them
+  if (!batch_->expired.empty()) {
+    MDNS_LOG_DEBUG(logger::mdns(),
+                   "{} cached records expired, {} left",
+                   batch_->expired.size(),
+                   record_cache_.size());
+    on_service_discovered_(*batch_);
+    batch_->clear();
+  }
+}
+
+void
+mdns::MdnsHelper::sendRefreshQueries(
+  std::vector<RecordCache::Refresh>& refresh)
+{
+  // Only records that answer one of our questions or belong to what the
+  // resolver followed are kept fresh, the rest of what the network says is
+  // left to expire (RFC 6762 5.2)
+  std::erase_if(refresh, [&](RecordCache::Refresh const& record) -> bool {
+    return !resolver_.interested(record.name_id) &&
+           std::ranges::none_of(query_names_,
+                                [&](KnownAnswers::Question const& question) {
+                                  return question.name_id == record.name_id;
+                                });
+  });
+
+  std::ranges::sort(refresh, {}, [](RecordCache::Refresh const& record) {
+    return std::pair(record.name_id, record.type);
+  });
+  auto const duplicates = std::ranges::unique(
+    refresh, {}, [](RecordCache::Refresh const& record) {
+      return std::pair(record.name_id, record.type);
+    });
+  refresh.erase(duplicates.begin(), duplicates.end());
+
+  if (refresh.empty()) {
+    return;
+  }
+
+  std::vector<KnownAnswers::Question> questions;
+
+  for (auto const& record : refresh) {
+    if (auto const& name = names_.lookup(record.name_id);
+        proto::mdns_is_encodable_name(name)) {
+      questions.push_back({ .name = std::string(name),
+                            .name_id = record.name_id,
+                            .type = record.type });
+    }
+  }
+
+  // Parse workers compare against the last refresh to drop its echo
+  if (pipeline_) {
+    pipeline_->wait_idle();
+  }
+
+  buildQuery(questions,
+             payload_ipv4_.load(std::memory_order_relaxed),
+             query_ipv4_.refresh);
+  buildQuery(questions,
+             payload_ipv6_.load(std::memory_order_relaxed),
+             query_ipv6_.refresh);
+
+  MDNS_LOG_DEBUG(logger::mdns(),
+                 "Refreshing {} cached records in {} IPv4 and {} IPv6 "
+                 "datagrams",
+                 refresh.size(),
+                 query_ipv4_.refresh.size(),
+                 query_ipv6_.refresh.size());
+  if (!impl_->send_multicast_all(query_ipv4_.refresh, query_ipv6_.refresh)) {
+    logger::mdns()->warn("Refresh query for {} cached records not sent",
+                         refresh.size());
+  }
 }
 
 void
 mdns::MdnsHelper::scheduleDiscoveryNow()
 {
-  logger::mdns()->info(
-    "Reseting last query timer. Will send query at the next iteration");
-  last_query_time_ = std::chrono::steady_clock::now() - query_interval_;
+  // Requests until the query goes out are served by it
+  if (query_scheduler_.requestNow()) {
+    logger::mdns()->info("Discovery query requested");
+    impl_->wake();
+  }
 }
 
 void
 mdns::MdnsHelper::runDiscovery(std::stop_token const& stop_token,
                                std::vector<sock_fd_t>&& sockets)
 {
-  scheduleDiscoveryNow();
+  if (!impl_->open_event_loop(sockets)) {
+    logger::mdns()->error("Unable to start the browsing event loop");
+  } else {
+    // The loop sleeps until there is something to do, a stop request is
+    // one more reason to wake it up
+    std::stop_callback const wake_on_stop(stop_token,
+                                          [this] { impl_->wake(); });
+
+    if (auto const threads = parse_threads_.load(std::memory_order_relaxed);
+        threads > 0) {
+      pipeline_ = std::make_unique<ParsePipeline>(
+        *this, threads, [this] { impl_->wake(); });
+    }
 
-  while (!stop_token.stop_requested()) {
-    if (auto now = std::chrono::steady_clock::now();
-        now - last_query_time_ >= query_interval_) {
-      auto const query = buildQuery(browsing_queries_);
+    auto armed = std::chrono::steady_clock::now();
+    record_cache_.clear();
+    resolver_.clear();
+    query_scheduler_.restart(armed);
+    armed = query_scheduler_.next(armed);
+    impl_->arm_query_timer(armed);
+
+    std::vector<proto::mdns_recv_res> messages;
+
+    while (!stop_token.stop_requested()) {
+      auto const events = impl_->wait_events(messages);
+      auto const now = std::chrono::steady_clock::now();
+
+      // Only a query that went out moves the backoff and counts as an
+      // attempt of the resolver
+      if (query_scheduler_.next(now) <= now) {
+        updateQueryPackets();
+
+        if (impl_->send_multicast_all(query_ipv4_.packets,
+                                      query_ipv6_.packets)) {
+          query_scheduler_.sent(now);
+          resolver_.sent(now);
+
+          MDNS_LOG_DEBUG(logger::mdns(),
+                         "Sent discovery query: {} sockets, {} IPv4 and {} "
+                         "IPv6 datagrams, next backoff {} ms",
+                         sockets.size(),
+                         query_ipv4_.packets.size(),
+                         query_ipv6_.packets.size(),
+                         query_scheduler_.interval().count());
+        } else {
+          query_scheduler_.failed(now);
+          logger::mdns()->warn("Discovery query not sent, retrying");
+        }
+      }
+
+      advanceRecordCache(now);
 
-      for (auto const socket : sockets) {
-        logger::mdns()->info("Sending discovery query: socket FD: " +
-                             std::to_string(socket));
-        impl_->send_multicast(socket, query.data(), query.size());
+      // Requests, sent queries and cached records move the deadline, the
+      // timer follows it
+      if (auto const due =
+            std::min(query_scheduler_.next(now), record_cache_.nextEvent());
+          due != armed) {
+        impl_->arm_query_timer(due);
+        armed = due;
       }
 
-      last_query_time_ = now;
-    }
+      // Only interfaces that just came up are queried, the others keep
+      // their schedule
+      if (events.interfaces_changed) {
+        if (auto const added = impl_->update_interfaces(sockets);
+            !added.empty()) {
+          updateQueryPackets();
 
-    std::vector<proto::mdns_response> result;
+          for (auto const& target : added) {
+            auto const& packets = target.family == AF_INET6
+                                    ? query_ipv6_.packets
+                                    : query_ipv4_.packets;
+
+            for (auto const& packet : packets) {
+              impl_->send_multicast(target, packet.data(), packet.size());
+            }
+          }
+        }
+      }
 
-    for (auto const messages = impl_->receive_discovery(sockets);
-         auto const& message : messages) {
-      logger::mdns()->trace("Processing multicast (" +
-                            std::to_string(message.blob.size()) + " bytes)");
+      if (pipeline_) {
+        // Duplicates are screened here, in arrival order, the workers only
+        // parse what is left
+        if (!messages.empty()) {
+          packetFilter();
+          dropDuplicates(messages);
+          pipeline_->submit(std::exchange(messages, {}));
+        }
 
-      if (auto const parsed = parseDiscoveryResponse(message);
-          parsed.has_value()) {
-        result.push_back(parsed.value());
-      } else {
-        logger::mdns()->warn("Multicast processing failed");
+        pipeline_->deliver(
+          [this](proto::mdns_batch const& batch) { publishBatch(batch); });
+      } else if (!messages.empty()) {
+        parseDiscoveryBatch(std::exchange(messages, {}), *batch_);
+        publishBatch(*batch_);
+        batch_->clear();
       }
     }
 
-    on_service_discovered_(std::move(result));
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // Chunks still in flight are dropped with the workers
+    pipeline_.reset();
+    impl_->close_event_loop();
   }
 
   logger::mdns()->info("Closing sockets");
@@ -193,14 +610,130 @@ mdns::MdnsHelper::runDiscovery(std::stop_token const& stop_token,
   logger::mdns()->info("Browsing thread stopped");
 }
 
+bool
+mdns::MdnsHelper::skipName(const std::uint8_t*& ptr, const std::uint8_t* end)
+{
+  while (ptr < end) {
+    std::uint8_t const len = *ptr;
+
+    if ((len & 0xC0) == 0xC0) {
+      if (ptr + 2 > end) {
+        return false;
+      }
+
+      // Pointer targets are validated when the name gets decoded
+      ptr += 2;
+      return true;
+    }
+
+    ptr++;
+
+    if (len == 0) {
+      return true;
+    }
+
+    if (ptr + len > end) {
+      return false;
+    }
+
+    ptr += len;
+  }
+
+  return false;
+}
+
+// Decoded suffixes of the compression pointer targets seen in one packet.
+// Holds a reference to the packet, so a recycled buffer address can never
+// produce a stale hit.
+struct mdns::MdnsHelper::NameCache
+{
+  struct Entry
+  {
+    std::uint32_t generation;
+    std::uint16_t offset;
+    std::uint32_t begin;
+    std::uint32_t length;
+  };
+
+  // Direct mapped by pointer offset, a collision just replaces the entry.
+  // Bumping the generation invalidates every entry without touching them.
+  static constexpr std::size_t slots = 64;
+
+  std::shared_ptr<std::uint8_t const[]> packet;
+  std::array<Entry, slots> entries{};
+  std::uint32_t generation = 0;
+  std::string text;
+
+  static std::size_t slot(std::uint16_t offset)
+  {
+    return (offset * 2654435761U) >> 26;
+  }
+
+  void reset(std::shared_ptr<std::uint8_t const[]> const& buffer)
+  {
+    packet = buffer;
+    text.clear();
+
+    if (++generation == 0) {
+      entries.fill({});
+      generation = 1;
+    }
+  }
+
+  const Entry* find(std::uint16_t offset) const
+  {
+    auto const& entry = entries[slot(offset)];
+    return entry.generation == generation && entry.offset == offset ? &entry
+                                                                    : nullptr;
+  }
+
+  std::uint32_t append(std::string_view suffix)
+  {
+    auto const begin = static_cast<std::uint32_t>(text.size());
+    text.append(suffix);
+    return begin;
+  }
+
+  void store(std::uint16_t offset, std::uint32_t begin, std::size_t length)
+  {
+    entries[slot(offset)] = {
+      generation, offset, begin, static_cast<std::uint32_t>(length)
+    };
+  }
+};
+
+mdns::MdnsHelper::NameCache&
+mdns::MdnsHelper::nameCacheFor(proto::mdns_packet_view const& packet)
+{
+  // Consecutive decodes from the same packet on this thread share the cache,
+  // the first decode from another packet starts a fresh one
+  thread_local NameCache cache;
+
+  if (cache.packet.get() != packet.begin()) {
+    cache.reset(packet.buffer);
+  }
+
+  return cache;
+}
+
 const std::uint8_t*
 mdns::MdnsHelper::parseName(const std::uint8_t*& ptr,
                             const std::uint8_t* start,
                             const std::uint8_t* end,
-                            std::string& out)
+                            std::pmr::string& out,
+                            NameCache* cache)
 {
   out.clear();
 
+  static constexpr int max_jumps = 10;
+
+  struct Jump
+  {
+    std::uint16_t offset;
+    std::size_t out_size;
+  };
+
+  std::array<Jump, max_jumps> jumps;
   const std::uint8_t* cur = ptr;
   const std::uint8_t* next = nullptr;
   int jumpCount = 0;
@@ -226,14 +759,20 @@ mdns::MdnsHelper::parseName(const std::uint8_t*& ptr,
         next = cur + 2;
       }
 
-      cur = start + offset;
       terminated = true;
 
-      if (++jumpCount > 10) {
+      if (const auto* hit = cache ? cache->find(offset) : nullptr) {
+        out.append(cache->text.data() + hit->begin, hit->length);
+        break;
+      }
+
+      if (jumpCount == max_jumps) {
         logger::mdns()->error("Compression pointer loop detected");
         return nullptr;
       }
 
+      jumps[jumpCount++] = { offset, out.size() };
+      cur = start + offset;
       continue;
     }
 
@@ -256,10 +795,23 @@ mdns::MdnsHelper::parseName(const std::uint8_t*& ptr,
   }
 
   if (!terminated) {
-    logger::mdns()->error("Malformed packet (name not terminated) -- " + out);
+    MDNS_LOG_ERROR(
+      logger::mdns(), "Malformed packet (name not terminated) -- {}", out);
     return nullptr;
   }
 
+  if (cache && jumpCount > 0) {
+    // Every later jump target is a tail of the first one, so the text is
+    // stored once and the inner targets point into it
+    auto const outer = std::string_view(out).substr(jumps[0].out_size);
+    auto const begin = cache->append(outer);
+
+    for (int i = 0; i < jumpCount; ++i) {
+      auto const skip = jumps[i].out_size - jumps[0].out_size;
+      cache->store(jumps[i].offset, begin + skip, outer.size() - skip);
+    }
+  }
+
   if (!out.empty()) {
     out.pop_back();
   }
@@ -268,14 +820,317 @@ mdns::MdnsHelper::parseName(const std::uint8_t*& ptr,
   return ptr;
 }
 
+// Per-type RDATA decoders, dispatched through a table indexed by the record
+// type. A decoder that rejects the RDATA logs why and leaves the record's
+// default rdata in place.
+struct mdns::MdnsHelper::RdataDecoders
+{
+  struct Context
+  {
+    MdnsHelper& helper;
+    const std::uint8_t* start;
+    const std::uint8_t* end;
+    const std::uint8_t* rdata;
+    const std::uint8_t* rdata_end;
+    NameCache* cache;
+    std::pmr::memory_resource* resource;
+  };
+
+  using Decoder = void (*)(Context const&, proto::mdns_rr&);
+
+  static void ptr(Context const& ctx, proto::mdns_rr& record);
+  static void txt(Context const& ctx, proto::mdns_rr& record);
+  static void srv(Context const& ctx, proto::mdns_rr& record);
+  static void a(Context const& ctx, proto::mdns_rr& record);
+  static void aaaa(Context const& ctx, proto::mdns_rr& record);
+  static void nsec(Context const& ctx, proto::mdns_rr& record);
+  static void cname(Context const& ctx, proto::mdns_rr& record);
+  static void hinfo(Context const& ctx, proto::mdns_rr& record);
+  static void opt(Context const& ctx, proto::mdns_rr& record);
+
+  // Every decoded type is below 64, anything above is unknown
+  static constexpr std::size_t table_size = 64;
+
+  static constexpr std::array<Decoder, table_size> table = [] {
+    std::array<Decoder, table_size> decoders{};
+    decoders[proto::MDNS_RECORDTYPE_A] = a;
+    decoders[proto::MDNS_RECORDTYPE_CNAME] = cname;
+    decoders[proto::MDNS_RECORDTYPE_PTR] = ptr;
+    decoders[proto::MDNS_RECORDTYPE_HINFO] = hinfo;
+    decoders[proto::MDNS_RECORDTYPE_TXT] = txt;
+    decoders[proto::MDNS_RECORDTYPE_AAAA] = aaaa;
+    decoders[proto::MDNS_RECORDTYPE_SRV] = srv;
+    decoders[proto::MDNS_RECORDTYPE_OPT] = opt;
+    decoders[proto::MDNS_RECORDTYPE_NSEC] = nsec;
+    return decoders;
+  }();
+
+  static Decoder find(std::uint16_t type)
+  {
+    return type < table_size ? table[type] : nullptr;
+  }
+};
+
+void
+mdns::MdnsHelper::RdataDecoders::ptr(Context const& ctx,
+                                     proto::mdns_rr& record)
+{
+  const std::uint8_t* tmp = ctx.rdata;
+
+  if (std::pmr::string target(ctx.resource);
+      parseName(tmp, ctx.start, ctx.end, target, ctx.cache)) {
+    // PTR records are listed under the empty name
+    auto const owner_id = record.name_id;
+    record.name.clear();
+    record.name_id = ctx.helper.names_.intern(record.name);
+    auto const target_id = ctx.helper.names_.intern(target);
+    record.rdata.emplace<proto::mdns_rr_ptr_ext>(
+      std::move(target), target_id, owner_id);
+  }
+}
+
+void
+mdns::MdnsHelper::RdataDecoders::txt(Context const& ctx,
+                                     proto::mdns_rr& record)
+{
+  const std::uint8_t* tmp = ctx.rdata;
+  auto& rr_txt = record.rdata.emplace<proto::mdns_rr_txt_ext>(
+    std::pmr::vector<std::pmr::string>(ctx.resource), record.name_id);
+
+  while (tmp < ctx.rdata_end) {
+    std::uint8_t len = *tmp++;
+    if (tmp + len > ctx.rdata_end) {
+      break;
+    }
+
+    auto const& txt =
+      rr_txt.entries.emplace_back(reinterpret_cast<const char*>(tmp), len);
+    record.name += txt;
+    tmp += len;
+  }
+}
+
+void
+mdns::MdnsHelper::RdataDecoders::srv(Context const& ctx,
+                                     proto::mdns_rr& record)
+{
+  if (ctx.rdata_end - ctx.rdata < 6) {
+    logger::mdns()->error("Malformed SRV record (too short)");
+    return;
+  }
+
+  const std::uint8_t* tmp = ctx.rdata;
+  proto::mdns_rr_srv_ext srv{ .target = std::pmr::string(ctx.resource) };
+
+  srv.priority = readU16(tmp);
+  srv.weight = readU16(tmp);
+  srv.port = readU16(tmp);
+
+  if (!parseName(tmp, ctx.start, ctx.end, srv.target, ctx.cache)) {
+    logger::mdns()->warn(
+      "Failed parsing name(MDNS_RECORDTYPE_SRV), dropping packet");
+    return;
+  }
+
+  MDNS_LOG_TRACE(logger::mdns(),
+                 "Discovered SRV record: {} -> {}:{} (prio={}, weight={})",
+                 record.name,
+                 srv.target,
+                 srv.port,
+                 srv.priority,
+                 srv.weight);
+
+  srv.target_id = ctx.helper.names_.intern(srv.target);
+  record.port = srv.port;
+  record.rdata.emplace<proto::mdns_rr_srv_ext>(std::move(srv));
+}
+
+void
+mdns::MdnsHelper::RdataDecoders::a(Context const& ctx, proto::mdns_rr& record)
+{
+  if (ctx.rdata_end - ctx.rdata != 4) {
+    return;
+  }
+
+  std::pmr::string advertisedIP(INET_ADDRSTRLEN, '\0', ctx.resource);
+
+  if (!inet_ntop(
+        AF_INET, ctx.rdata, advertisedIP.data(), advertisedIP.size())) {
+    MDNS_LOG_TRACE(logger::mdns(), "Failed parsing MDNS_RECORDTYPE_A packet");
+    return;
+  }
+
+  advertisedIP.resize(std::strlen(advertisedIP.c_str()));
+
+  MDNS_LOG_TRACE(logger::mdns(),
+                 "Discovered A record: {} / {}",
+                 advertisedIP,
+                 record.name);
+  record.rdata.emplace<proto::mdns_rr_a_ext>(std::move(advertisedIP));
+}
+
+void
+mdns::MdnsHelper::RdataDecoders::aaaa(Context const& ctx,
+                                      proto::mdns_rr& record)
+{
+  if (ctx.rdata_end - ctx.rdata != 16) {
+    return;
+  }
+
+  std::pmr::string advertisedIP(INET6_ADDRSTRLEN, '\0', ctx.resource);
+
+  if (!inet_ntop(
+        AF_INET6, ctx.rdata, advertisedIP.data(), advertisedIP.size())) {
+    MDNS_LOG_TRACE(logger::mdns(),
+                   "Failed parsing MDNS_RECORDTYPE_AAAA packet");
+    return;
+  }
+
+  advertisedIP.resize(std::strlen(advertisedIP.c_str()));
+
+  MDNS_LOG_TRACE(logger::mdns(),
+                 "Discovered AAAA record: {} / {}",
+                 advertisedIP,
+                 record.name);
+  record.rdata.emplace<proto::mdns_rr_aaaa_ext>(std::move(advertisedIP));
+}
+
+void
+mdns::MdnsHelper::RdataDecoders::nsec(Context const& ctx,
+                                      proto::mdns_rr& record)
+{
+  const std::uint8_t* tmp = ctx.rdata;
+  proto::mdns_rr_nsec_ext nsec{ std::pmr::string(ctx.resource),
+                                std::pmr::vector<uint16_t>(ctx.resource) };
+
+  if (!parseName(tmp, ctx.start, ctx.end, nsec.next_domain, ctx.cache)) {
+    logger::mdns()->warn("Failed parsing NSEC next domain");
+    return;
+  }
+
+  while (tmp < ctx.rdata_end) {
+    if (tmp + 2 > ctx.rdata_end) {
+      logger::mdns()->warn("Malformed NSEC bitmap");
+      break;
+    }
+
+    uint8_t window = *tmp++;
+    uint8_t len = *tmp++;
+
+    if (tmp + len > ctx.rdata_end) {
+      logger::mdns()->warn("NSEC bitmap overflow");
+      break;
+    }
+
+    for (uint8_t i = 0; i < len; ++i) {
+      uint8_t byte = tmp[i];
+      for (int bit = 0; bit < 8; ++bit) {
+        if (byte & (1 << (7 - bit))) {
+          uint16_t rrtype = window * 256 + i * 8 + bit;
+          nsec.types.push_back(rrtype);
+        }
+      }
+    }
+
+    tmp += len;
+  }
+
+  MDNS_LOG_TRACE(logger::mdns(),
+                 "NSEC record for {} indicates {} types",
+                 record.name,
+                 nsec.types.size());
+
+  record.rdata.emplace<proto::mdns_rr_nsec_ext>(std::move(nsec));
+}
+
+void
+mdns::MdnsHelper::RdataDecoders::cname(Context const& ctx,
+                                       proto::mdns_rr& record)
+{
+  const std::uint8_t* tmp = ctx.rdata;
+  std::pmr::string target(ctx.resource);
+
+  if (!parseName(tmp, ctx.start, ctx.end, target, ctx.cache)) {
+    logger::mdns()->warn("Failed parsing CNAME target");
+    return;
+  }
+
+  MDNS_LOG_TRACE(
+    logger::mdns(), "Discovered CNAME record: {} -> {}", record.name, target);
+
+  auto const target_id = ctx.helper.names_.intern(target);
+  record.rdata.emplace<proto::mdns_rr_cname_ext>(std::move(target), target_id);
+}
+
+void
+mdns::MdnsHelper::RdataDecoders::hinfo(Context const& ctx,
+                                       proto::mdns_rr& record)
+{
+  const std::uint8_t* tmp = ctx.rdata;
+  std::array<std::string_view, 2> fields;
+
+  // CPU and OS, one character-string each
+  for (auto& field : fields) {
+    if (tmp >= ctx.rdata_end || tmp + 1 + *tmp > ctx.rdata_end) {
+      logger::mdns()->warn("Malformed HINFO record");
+      return;
+    }
+
+    field = { reinterpret_cast<const char*>(tmp + 1), *tmp };
+    tmp += 1 + *tmp;
+  }
+
+  record.rdata.emplace<proto::mdns_rr_hinfo_ext>(
+    std::pmr::string(fields[0], ctx.resource),
+    std::pmr::string(fields[1], ctx.resource));
+}
+
+void
+mdns::MdnsHelper::RdataDecoders::opt(Context const& ctx,
+                                     proto::mdns_rr& record)
+{
+  const std::uint8_t* tmp = ctx.rdata;
+  proto::mdns_rr_opt_ext opt{
+    .udp_payload_size = record.clazz,
+    .extended_rcode = static_cast<std::uint8_t>(record.ttl >> 24),
+    .version = static_cast<std::uint8_t>(record.ttl >> 16),
+    .dnssec_ok = (record.ttl & 0x8000U) != 0,
+    .options = std::pmr::vector<proto::mdns_edns_option>(ctx.resource),
+  };
+
+  while (tmp < ctx.rdata_end) {
+    if (tmp + 4 > ctx.rdata_end) {
+      logger::mdns()->warn("Malformed EDNS0 option");
+      break;
+    }
+
+    auto const code = readU16(tmp);
+    auto const len = readU16(tmp);
+
+    if (tmp + len > ctx.rdata_end) {
+      logger::mdns()->warn("EDNS0 option overflow");
+      break;
+    }
+
+    opt.options.push_back(
+      { code, std::pmr::vector<std::uint8_t>(tmp, tmp + len, ctx.resource) });
+    tmp += len;
+  }
+
+  record.rdata.emplace<proto::mdns_rr_opt_ext>(std::move(opt));
+}
+
 mdns::proto::mdns_rr
 mdns::MdnsHelper::parseRR(const std::uint8_t*& ptr,
-                          const std::uint8_t* start,
-                          const std::uint8_t* end)
+                          proto::mdns_packet_view const& packet,
+                          NameCache* cache,
+                          std::pmr::memory_resource* resource)
 {
-  proto::mdns_rr record{};
+  const std::uint8_t* start = packet.begin();
+  const std::uint8_t* end = packet.end();
+  proto::mdns_rr record(resource);
 
-  const auto* name_end = parseName(ptr, start, end, record.name);
+  const auto* name_end = parseName(ptr, start, end, record.name, cache);
   if (!name_end) {
     logger::mdns()->error("Malformed RR (bad owner name)");
     return record;
@@ -301,251 +1156,279 @@ mdns::MdnsHelper::parseRR(const std::uint8_t*& ptr,
   const std::uint8_t* rdata_start = ptr;
   const std::uint8_t* rdata_end = ptr + rdlen;
 
-  switch (record.type) {
-    case mdns::proto::MDNS_RECORDTYPE_PTR: {
-      const std::uint8_t* tmp = rdata_start;
+  // Interned before a decoder edits the name for display, so only owner
+  // names reach the table and never TXT payloads
+  record.name_id = names_.intern(record.name);
+
+  if (auto const decode = RdataDecoders::find(record.type)) {
+    decode({ *this, start, end, rdata_start, rdata_end, cache, resource },
+           record);
+  } else {
+    // Expected on a busy network, only counted
+    unknown_records_.fetch_add(1, std::memory_order_relaxed);
+    record.rdata.emplace<proto::mdns_rr_unknown_ext>(
+      std::shared_ptr<std::uint8_t const[]>(packet.buffer, rdata_start),
+      rdlen);
+  }
 
-      if (std::string target; parseName(tmp, start, end, target)) {
-        record.name = "";
-        record.rdata = mdns::proto::mdns_rr_ptr_ext{ target };
-      }
-    } break;
+  MDNS_LOG_TRACE(logger::mdns(),
+                 "Parsed RR: name='{}' type={} class={} ttl={} rdlen={}",
+                 record.name,
+                 record.type,
+                 record.clazz,
+                 record.ttl,
+                 rdlen);
 
-    case mdns::proto::MDNS_RECORDTYPE_TXT: {
-      const std::uint8_t* tmp = rdata_start;
-      mdns::proto::mdns_rr_txt_ext rr_txt{};
+  ptr = rdata_end;
+  return record;
+}
 
-      while (tmp < rdata_end) {
-        std::uint8_t len = *tmp++;
-        if (tmp + len > rdata_end) {
-          break;
-        }
+std::uint16_t
+mdns::MdnsHelper::readU16(const std::uint8_t*& ptr)
+{
+  // Fields sit at any offset of the datagram, memcpy avoids misaligned loads
+  std::uint16_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+  ptr += sizeof(value);
+  return ntohs(value);
+}
 
-        std::string txt(reinterpret_cast<const char*>(tmp), len);
-        rr_txt.entries.emplace_back(txt);
-        record.name += txt;
-        tmp += len;
-      }
+std::uint32_t
+mdns::MdnsHelper::readU32(const std::uint8_t*& ptr)
+{
+  std::uint32_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+  ptr += sizeof(value);
+  return ntohl(value);
+}
 
-      record.rdata = rr_txt;
-    } break;
+std::optional<mdns::proto::mdns_response_view>
+mdns::MdnsHelper::parseDiscoveryView(proto::mdns_recv_res&& message,
+                                     std::pmr::memory_resource* resource)
+{
+  auto view = parseHeaderView(std::move(message), resource);
+  if (view.has_value()) {
+    indexRecords(view.value());
+  }
 
-    case mdns::proto::MDNS_RECORDTYPE_SRV: {
-      if (rdlen < 6) {
-        logger::mdns()->error("Malformed SRV record (too short)");
-        break;
-      }
+  return view;
+}
+
+std::optional<mdns::proto::mdns_response>
+mdns::MdnsHelper::parseDiscoveryResponse(proto::mdns_recv_res&& message,
+                                         std::pmr::memory_resource* resource)
+{
+  auto const view = parseDiscoveryView(std::move(message), resource);
+  if (!view.has_value()) {
+    return std::nullopt;
+  }
 
-      const std::uint8_t* tmp = rdata_start;
-      mdns::proto::mdns_rr_srv_ext srv;
+  return decodeResponse(view.value(), resource);
+}
 
-      srv.priority = readU16(tmp);
-      srv.weight = readU16(tmp);
-      srv.port = readU16(tmp);
+std::optional<mdns::proto::mdns_response_view>
+mdns::MdnsHelper::parseHeaderView(proto::mdns_recv_res&& message,
+                                  std::pmr::memory_resource* resource)
+{
+  if (message.packet.size < sizeof(std::uint16_t) * 6) {
+    MDNS_LOG_WARN(logger::mdns(),
+                  "mDNS packet too small: {} bytes",
+                  message.packet.size);
+    return std::nullopt;
+  }
 
-      if (!parseName(tmp, start, end, srv.target)) {
-        logger::mdns()->warn(
-          "Failed parsing name(MDNS_RECORDTYPE_SRV), dropping packet");
-        break;
-      }
+  proto::mdns_response_view response(resource);
 
-      logger::mdns()->trace(
-        fmt::format("Discovered SRV record: {} -> {}:{} (prio={}, weight={})",
-                    record.name,
-                    srv.target,
-                    srv.port,
-                    srv.priority,
-                    srv.weight));
-
-      record.port = srv.port;
-      record.rdata = std::move(srv);
-    } break;
-
-    case mdns::proto::MDNS_RECORDTYPE_A: {
-      if (rdlen == 4) {
-        std::string advertisedIP;
-        advertisedIP.resize(INET_ADDRSTRLEN);
-
-        if (!inet_ntop(
-              AF_INET, rdata_start, advertisedIP.data(), advertisedIP.size())) {
-          logger::mdns()->trace("Failed parsing MDNS_RECORDTYPE_A packet");
-          break;
-        }
+  // Take over the receive buffer instead of copying it, every view decoded
+  // from this datagram shares ownership of it
+  response.packet = std::move(message.packet);
+  response.source = message.source;
+  response.ifindex = message.ifindex;
 
-        advertisedIP.resize(std::strlen(advertisedIP.c_str()));
+  const auto* packet_start = response.packet.begin();
+  const auto* packet_end = response.packet.end();
+  const auto* data = packet_start;
 
-        logger::mdns()->trace("Discovered A record: " + advertisedIP + " / " +
-                              record.name);
-        record.rdata = mdns::proto::mdns_rr_a_ext{ advertisedIP };
-      }
-    } break;
-
-    case mdns::proto::MDNS_RECORDTYPE_AAAA: {
-      if (rdlen == 16) {
-        std::string advertisedIP;
-        advertisedIP.resize(INET6_ADDRSTRLEN);
-
-        if (!inet_ntop(AF_INET6,
-                       rdata_start,
-                       advertisedIP.data(),
-                       advertisedIP.size())) {
-          logger::mdns()->trace("Failed parsing MDNS_RECORDTYPE_AAAA packet");
-          break;
-        }
+  response.time_of_arrival =
+    message.time_of_arrival != std::chrono::steady_clock::time_point{}
+      ? message.time_of_arrival
+      : std::chrono::steady_clock::now();
+  response.query_id = readU16(data);
+  response.flags = readU16(data);
+  response.questions = readU16(data);
+  response.answers = readU16(data);
+  response.authorities = readU16(data);
+  response.additionals = readU16(data);
 
-        advertisedIP.resize(std::strlen(advertisedIP.c_str()));
-        logger::mdns()->trace("Discovered AAAA record: " + advertisedIP +
-                              " / " + record.name);
-        record.rdata = mdns::proto::mdns_rr_a_ext{ advertisedIP };
-      }
-    } break;
+  MDNS_LOG_TRACE(logger::mdns(),
+                 "Header: id={} flags=0x{:04X} qd={} an={} ns={} ar={}",
+                 response.query_id,
+                 response.flags,
+                 response.questions,
+                 response.answers,
+                 response.authorities,
+                 response.additionals);
 
-    case mdns::proto::MDNS_RECORDTYPE_NSEC: {
-      const std::uint8_t* tmp = rdata_start;
-      mdns::proto::mdns_rr_nsec_ext nsec;
+  response.questions_list.reserve(response.questions);
 
-      if (!parseName(tmp, start, end, nsec.next_domain)) {
-        logger::mdns()->warn("Failed parsing NSEC next domain");
-        break;
-      }
+  for (std::uint16_t i = 0; i < response.questions; ++i) {
+    proto::mdns_question_view q{};
+    q.name = static_cast<std::uint16_t>(data - packet_start);
 
-      while (tmp < rdata_end) {
-        if (tmp + 2 > rdata_end) {
-          logger::mdns()->warn("Malformed NSEC bitmap");
-          break;
-        }
+    if (!skipName(data, packet_end) || data + 4 > packet_end) {
+      logger::mdns()->error("Malformed packet (bad question name)");
+      return std::nullopt;
+    }
+
+    q.type = readU16(data);
+    q.clazz = readU16(data);
+    response.questions_list.push_back(q);
+  }
 
-        uint8_t window = *tmp++;
-        uint8_t len = *tmp++;
+  response.records_offset = static_cast<std::uint16_t>(data - packet_start);
 
-        if (tmp + len > rdata_end) {
-          logger::mdns()->warn("NSEC bitmap overflow");
-          break;
-        }
+  return response;
+}
 
-        for (uint8_t i = 0; i < len; ++i) {
-          uint8_t byte = tmp[i];
-          for (int bit = 0; bit < 8; ++bit) {
-            if (byte & (1 << (7 - bit))) {
-              uint16_t rrtype = window * 256 + i * 8 + bit;
-              nsec.types.push_back(rrtype);
-            }
-          }
-        }
+void
+mdns::MdnsHelper::indexRecords(proto::mdns_response_view& response)
+{
+  const auto* packet_start = response.packet.begin();
+  const auto* packet_end = response.packet.end();
+  const auto* data = packet_start + response.records_offset;
+
+  auto index_rr_block = [&](std::pmr::vector<proto::mdns_rr_view>& out,
+                            std::uint16_t count) -> bool {
+    out.reserve(count);
 
-        tmp += len;
+    for (std::uint16_t i = 0; i < count; ++i) {
+      proto::mdns_rr_view rr{};
+      rr.offset = static_cast<std::uint16_t>(data - packet_start);
+
+      if (!skipName(data, packet_end) || data + 10 > packet_end) {
+        logger::mdns()->error("Malformed packet (bad RR parse)");
+        return false;
       }
 
-      logger::mdns()->trace(fmt::format("NSEC record for {} indicates {} types",
-                                        record.name,
-                                        nsec.types.size()));
+      rr.type = readU16(data);
+      rr.clazz = readU16(data);
+      rr.ttl = readU32(data);
+      rr.rdata_length = readU16(data);
 
-      record.rdata = std::move(nsec);
-    } break;
+      if (data + rr.rdata_length > packet_end) {
+        logger::mdns()->error("Malformed RR (RDATA overrun)");
+        return false;
+      }
 
-    default: {
-      logger::mdns()->error(fmt::format(
-        "Failed parsing RR, setting type to unknown: {}", record.type));
-      record.rdata = mdns::proto::mdns_rr_unknown_ext{
-        std::vector<std::uint8_t>{ rdata_start, rdata_end }
-      };
-    } break;
-  }
+      rr.rdata_offset = static_cast<std::uint16_t>(data - packet_start);
+      data += rr.rdata_length;
+      out.push_back(rr);
+    }
 
-  logger::mdns()->trace(
-    fmt::format("Parsed RR: name='{}' type={} class={} ttl={} rdlen={}",
-                record.name,
-                record.type,
-                record.clazz,
-                record.ttl,
-                rdlen));
+    return true;
+  };
 
-  ptr = rdata_end;
-  return record;
+  // A malformed RR ends the packet, records indexed before it are kept
+  index_rr_block(response.answer_rrs, response.answers) &&
+    index_rr_block(response.authority_rrs, response.authorities) &&
+    index_rr_block(response.additional_rrs, response.additionals);
 }
 
-std::uint16_t
-mdns::MdnsHelper::readU16(const std::uint8_t*& ptr)
+bool
+mdns::MdnsHelper::acceptPacket(proto::mdns_response_view const& view,
+                               proto::mdns_packet_filter const& filter) const
 {
-  auto const result = ntohs(*reinterpret_cast<const std::uint16_t*>(ptr));
-  ptr += sizeof(std::uint16_t);
-  return result;
-}
+  bool const is_response = (view.flags & proto::response_flag) != 0;
 
-std::uint32_t
-mdns::MdnsHelper::readU32(const std::uint8_t*& ptr)
-{
-  auto const result = ntohl(*reinterpret_cast<const std::uint32_t*>(ptr));
-  ptr += sizeof(std::uint32_t);
-  return result;
-}
+  if (is_response ? filter.drop_responses : filter.drop_queries) {
+    return false;
+  }
 
-std::optional<mdns::proto::mdns_response>
-mdns::MdnsHelper::parseDiscoveryResponse(proto::mdns_recv_res const& message)
-{
-  auto const& buffer = message.blob;
+  // Multicast loopback hands our own queries back, they are the exact bytes
+  // last sent
+  auto const sent = [&](std::vector<std::uint8_t> const& packet) -> bool {
+    return std::ranges::equal(
+      std::span(view.packet.begin(), view.packet.size), packet);
+  };
+  auto const sent_by = [&](QueryFamily const& family) -> bool {
+    return std::ranges::any_of(family.packets, sent) ||
+           std::ranges::any_of(family.refresh, sent);
+  };
 
-  if (buffer.size() < sizeof(std::uint16_t) * 6) {
-    logger::mdns()->warn(
-      "mDNS packet too small: " + std::to_string(buffer.size()) + " bytes");
-    return std::nullopt;
+  if (filter.drop_own_queries && !is_response &&
+      (sent_by(query_ipv4_) || sent_by(query_ipv6_))) {
+    return false;
   }
 
-  const auto* packet_start = reinterpret_cast<const uint8_t*>(buffer.data());
-  const auto* packet_end = packet_start + buffer.size();
-  const auto* data = packet_start;
+  return std::ranges::none_of(
+    denied_sources_, [&](proto::mdns_endpoint const& source) -> bool {
+      return source.same_address(view.source);
+    });
+}
 
-  proto::mdns_response response{};
-  response.packet.assign(packet_start, packet_end);
+bool
+mdns::MdnsHelper::decodeName(proto::mdns_packet_view const& packet,
+                             std::uint16_t offset,
+                             std::pmr::string& out)
+{
+  const auto* ptr = packet.begin() + offset;
+  auto& cache = nameCacheFor(packet);
+  return parseName(ptr, packet.begin(), packet.end(), out, &cache) != nullptr;
+}
+
+std::optional<mdns::proto::mdns_rr>
+mdns::MdnsHelper::decodeRR(proto::mdns_packet_view const& packet,
+                           proto::mdns_rr_view const& rr,
+                           std::pmr::memory_resource* resource)
+{
+  const auto* data = packet.begin() + rr.offset;
+  auto record = parseRR(data, packet, &nameCacheFor(packet), resource);
 
-  if (data + 12 > packet_end) {
-    logger::mdns()->error("Malformed packet (truncated header)");
+  if (data != packet.begin() + rr.rdata_offset + rr.rdata_length) {
     return std::nullopt;
   }
 
-  response.time_of_arrival = std::chrono::steady_clock::now();
-  response.query_id = readU16(data);
-  response.flags = readU16(data);
-  response.questions = readU16(data);
+  return record;
+}
 
-  std::uint16_t const answer_rrs = readU16(data);
-  std::uint16_t const authority_rrs = readU16(data);
-  std::uint16_t const additional_rrs = readU16(data);
+mdns::proto::mdns_response
+mdns::MdnsHelper::decodeResponse(proto::mdns_response_view const& view,
+                                 std::pmr::memory_resource* resource)
+{
+  proto::mdns_response response(resource);
+  response.query_id = view.query_id;
+  response.flags = view.flags;
+  response.questions = view.questions;
+  response.packet = view.packet;
+  response.source = view.source;
+  response.ifindex = view.ifindex;
+  response.time_of_arrival = view.time_of_arrival;
 
-  logger::mdns()->trace(
-    fmt::format("Header: id={} flags=0x{:04X} qd={} an={} ns={} ar={}",
-                response.query_id,
-                response.flags,
-                response.questions,
-                answer_rrs,
-                authority_rrs,
-                additional_rrs));
+  response.questions_list.reserve(view.questions_list.size());
 
-  for (std::uint16_t i = 0; i < response.questions; ++i) {
-    proto::mdns_question q{};
+  for (auto const& qv : view.questions_list) {
+    proto::mdns_question q(resource);
 
-    const auto* name_end = parseName(data, packet_start, packet_end, q.name);
-    if (!name_end || name_end + 4 > packet_end) {
+    if (!decodeName(view.packet, qv.name, q.name)) {
       logger::mdns()->error("Malformed packet (bad question name)");
-      return std::nullopt;
+      continue;
     }
 
-    data = name_end;
-    q.type = readU16(data);
-    q.clazz = readU16(data);
+    q.type = qv.type;
+    q.clazz = qv.clazz;
 
-    logger::mdns()->info("Pushed question query: " + q.name);
+    MDNS_LOG_TRACE(logger::mdns(), "Pushed question query: {}", q.name);
     response.questions_list.push_back(std::move(q));
   }
 
-  auto parse_rr_block = [&](std::vector<proto::mdns_rr>& out,
-                            std::uint16_t count,
-                            std::string& advertizedIP) -> void {
-    for (std::uint16_t i = 0; i < count; ++i) {
-      const auto* before = data;
+  auto decode_rr_block = [&](std::pmr::vector<proto::mdns_rr>& out,
+                             std::pmr::vector<proto::mdns_rr_view> const& rrs,
+                             std::pmr::string& advertizedIP) -> void {
+    out.reserve(rrs.size());
 
-      auto rr = parseRR(data, packet_start, packet_end);
-      if (data <= before || data > packet_end) {
+    for (auto const& rv : rrs) {
+      auto rr = decodeRR(view.packet, rv, resource);
+      if (!rr.has_value()) {
         logger::mdns()->error("Malformed packet (bad RR parse)");
         continue;
       }
@@ -561,27 +1444,81 @@ mdns::MdnsHelper::parseDiscoveryResponse(proto::mdns_recv_res const& message)
             advertizedIP = entry.address;
           }
         },
-        rr.rdata);
+        rr->rdata);
 
-      out.push_back(std::move(rr));
+      out.push_back(std::move(rr.value()));
     }
-
-    return;
   };
 
-  parse_rr_block(
-    response.answer_rrs, answer_rrs, response.advertized_ip_addr_str);
-  parse_rr_block(
-    response.authority_rrs, authority_rrs, response.advertized_ip_addr_str);
-  parse_rr_block(
-    response.additional_rrs, additional_rrs, response.advertized_ip_addr_str);
-
-  response.ip_addr_str = message.ip_addr_str;
-  response.port = message.port;
+  decode_rr_block(
+    response.answer_rrs, view.answer_rrs, response.advertized_ip_addr_str);
+  decode_rr_block(response.authority_rrs,
+                  view.authority_rrs,
+                  response.advertized_ip_addr_str);
+  decode_rr_block(response.additional_rrs,
+                  view.additional_rrs,
+                  response.advertized_ip_addr_str);
 
   return response;
 }
 
+void
+mdns::MdnsHelper::parseDiscoveryBatch(
+  std::vector<proto::mdns_recv_res>&& messages,
+  proto::mdns_batch& batch)
+{
+  auto const& filter = packetFilter();
+  dropDuplicates(messages);
+  parseMessages(messages, batch, filter);
+}
+
+void
+mdns::MdnsHelper::dropDuplicates(std::vector<proto::mdns_recv_res>& messages)
+{
+  auto const now = DuplicateFilter::clock::now();
+
+  auto const removed = std::erase_if(
+    messages, [&](proto::mdns_recv_res const& message) -> bool {
+      return duplicates_.seen(message, now);
+    });
+
+  duplicate_packets_.fetch_add(removed, std::memory_order_relaxed);
+}
+
+void
+mdns::MdnsHelper::parseMessages(std::span<proto::mdns_recv_res> messages,
+                                proto::mdns_batch& batch,
+                                proto::mdns_packet_filter const& filter)
+{
+  batch.responses.reserve(messages.size());
+
+  for (auto& message : messages) {
+    MDNS_LOG_TRACE(logger::mdns(),
+                   "Processing multicast ({} bytes)",
+                   message.packet.size);
+
+    // The view only lives until its response is decoded, so it shares the
+    // arena with the response instead of going through the heap
+    auto view = parseHeaderView(std::move(message), &batch.arena);
+    if (!view.has_value()) {
+      logger::mdns()->warn("Multicast processing failed");
+      continue;
+    }
+
+    // Records of a rejected packet are never looked at
+    if (!acceptPacket(view.value(), filter)) {
+      filtered_packets_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    if (!filter.questions_only) {
+      indexRecords(view.value());
+    }
+
+    batch.responses.push_back(decodeResponse(view.value(), &batch.arena));
+  }
+}
+
 void
 mdns::MdnsHelper::connectOnServiceDiscovered(service_dicovered_cb cb)
 {
@@ -2,18 +2,188 @@
 #define MDNSLINUXIMPL_HPP
 
 #include "MdnsHelper.h"
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
 #include <vector>
 
+#ifndef WIN32
+#include <array>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
 struct mdns::MdnsHelper::BackendImpl
 {
+  // What woke wait_events up, datagrams are appended to its output
+  struct events
+  {
+    bool query_due = false;
+    bool woken = false;
+    // An interface came up, went down or changed its addresses
+    bool interfaces_changed = false;
+  };
+
+  // An interface of one family that queries go out on
+  struct send_target
+  {
+    int family = 0;
+    unsigned ifindex = 0;
+  };
+
   BackendImpl();
   ~BackendImpl();
   std::vector<sock_fd_t> open_client_sockets_foreach_iface(std::size_t max,
                                                            int port);
-  int send_multicast(sock_fd_t sock, void const* buffer, std::size_t size);
-  std::vector<proto::mdns_recv_res> receive_discovery(
-    std::vector<sock_fd_t> const& sockets);
+  int send_multicast(send_target const& target,
+                     void const* buffer,
+                     std::size_t size);
   void close(sock_fd_t sock);
+
+  // Picks up interfaces that appeared since the last call and drops those
+  // that are gone. Sockets opened on the way are added to sockets, the
+  // interfaces that came up are returned.
+  std::vector<send_target> update_interfaces(std::vector<sock_fd_t>& sockets);
+
+  // Sends the datagrams of a query on every interface of the event loop, in
+  // order and as a single batch per datagram where the backend supports it.
+  // Each family gets the datagrams packed for its payload budget. False
+  // when no datagram went out on any socket.
+  bool send_multicast_all(std::span<std::vector<std::uint8_t> const> ipv4,
+                          std::span<std::vector<std::uint8_t> const> ipv6);
+
+  // Event loop of the browsing thread. It sleeps until a socket is readable,
+  // the query timer expires or wake() is called from another thread.
+  bool open_event_loop(std::vector<sock_fd_t> const& sockets);
+  // One-shot, the timer fires once at due and stays quiet until re-armed
+  void arm_query_timer(std::chrono::steady_clock::time_point due);
+  events wait_events(std::vector<proto::mdns_recv_res>& out);
+  void wake();
+  void close_event_loop();
+
+private:
+  void receive_from(sock_fd_t sock, std::vector<proto::mdns_recv_res>& out);
+
+  // Largest mDNS message (RFC 6762, section 17)
+  static constexpr std::size_t recv_buffer_size = 9000;
+
+  std::vector<sock_fd_t> sockets_;
+
+#ifdef WIN32
+  int send_to_group(sock_fd_t sock, void const* buffer, std::size_t size);
+
+  void* recv_event_ = nullptr;
+  void* wake_event_ = nullptr;
+  std::chrono::steady_clock::time_point next_query_{
+    std::chrono::steady_clock::time_point::max()
+  };
+#else
+  // io_uring when the kernel supports multishot receives and provided
+  // buffer rings, epoll with recvmmsg otherwise
+  struct Uring;
+
+  // First usable address of an interface and family
+  struct interface_addr
+  {
+    int family = AF_UNSPEC;
+    unsigned ifindex = 0;
+    sockaddr_storage addr{};
+    std::string name;
+    std::string address;
+  };
+
+  // Resolved once when an interface comes up. Its queries leave through
+  // the listener of its family, PKTINFO picks the interface and source.
+  struct send_context
+  {
+    int family = AF_UNSPEC;
+    unsigned ifindex = 0;
+    sockaddr_storage local{};
+  };
+
+  // Room for an IP_PKTINFO or IPV6_PKTINFO control message
+  static constexpr std::size_t control_size = CMSG_SPACE(sizeof(in6_pktinfo));
+  // Received datagrams also carry their SO_TIMESTAMPNS time
+  static constexpr std::size_t recv_control_size =
+    control_size + CMSG_SPACE(sizeof(timespec));
+
+  // Kernel timestamps are CLOCK_REALTIME, both clocks are read once per
+  // receive batch to move them to steady_clock
+  struct clock_pair
+  {
+    std::chrono::system_clock::time_point wall;
+    std::chrono::steady_clock::time_point steady;
+
+    static clock_pair now();
+  };
+
+  // A query is sent with one sendmmsg per family, every message picks its
+  // interface and source address with IP_PKTINFO or IPV6_PKTINFO
+  struct fanout_message
+  {
+    iovec iov;
+    alignas(cmsghdr) std::array<std::uint8_t, control_size> control;
+  };
+
+  struct fanout_family
+  {
+    sock_fd_t sock = -1;
+    sockaddr_storage group{};
+    std::vector<fanout_message> messages;
+    std::vector<mmsghdr> headers;
+  };
+
+  bool open_epoll();
+  static std::vector<interface_addr> scan_interfaces();
+  bool open_interface(interface_addr const& iface,
+                      std::vector<sock_fd_t>& sockets);
+  void watch_socket(sock_fd_t sock);
+  bool read_interface_events();
+  void add_send_context(int family, sockaddr const* local, unsigned ifindex);
+  send_context const* find_send_context(send_target const& target) const;
+  sock_fd_t& listener(int family);
+  void build_fanout();
+  void refresh_fanout();
+  static void set_fanout_payload(fanout_family& fanout,
+                                 void const* buffer,
+                                 std::size_t size);
+  static proto::mdns_endpoint to_endpoint(sockaddr_storage const& addr);
+  static socklen_t multicast_group(int family, sockaddr_storage& addr);
+  static std::size_t pktinfo(send_context const& context,
+                             std::uint8_t* control);
+  static void read_control(msghdr const& hdr,
+                           clock_pair const& clocks,
+                           proto::mdns_recv_res& recv_res);
+
+  std::unique_ptr<Uring> uring_;
+  // Shared mDNS port listener of each family, -1 until an interface of the
+  // family comes up
+  sock_fd_t listener_ipv4_ = -1;
+  sock_fd_t listener_ipv6_ = -1;
+  std::vector<send_context> send_contexts_;
+  std::vector<fanout_family> fanout_;
+  // Interfaces changed while a query was in flight, the fan-out is rebuilt
+  // before the next one
+  bool fanout_stale_ = false;
+  std::size_t max_interfaces_ = 0;
+
+  // Datagrams are received straight into pooled buffers. A buffer goes back
+  // into rotation once no packet view references it anymore.
+  static constexpr std::size_t recv_batch = 16;
+  static constexpr std::size_t recv_pool_limit = 64;
+
+  std::shared_ptr<std::uint8_t[]> acquire_buffer();
+
+  std::vector<std::shared_ptr<std::uint8_t[]>> recv_pool_;
+  std::size_t recv_cursor_ = 0;
+
+  int epoll_fd_ = -1;
+  int timer_fd_ = -1;
+  int event_fd_ = -1;
+  // rtnetlink socket notified of link and address changes
+  int netlink_fd_ = -1;
+#endif
 };
 
 #endif // MDNSLINUXIMPL_HPP
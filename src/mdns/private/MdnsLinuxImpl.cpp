@@ -2,15 +2,24 @@
 
 #include "../include/Proto.h"
 #include "MdnsImpl.hpp"
+#include "MdnsUringImpl.hpp"
 #include <Logger.h>
+#include <algorithm>
 #include <arpa/inet.h>
+#include <array>
 #include <cstdio>
+#include <cstring>
 #include <ifaddrs.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/fcntl.h>
 #include <sys/socket.h>
+#include <sys/timerfd.h>
 #include <type_traits>
 #include <unistd.h>
 
@@ -77,179 +86,251 @@ getErrnoString()
   return err ? err : "";
 }
 
-int
-initalizeIpv4Socket(sockaddr_in* sockaddr, int port)
+// An address still in duplicate address detection cannot be bound, nor
+// used as a source. Another RTM_NEWADDR follows once it is usable.
+bool
+isTentative(sockaddr_in6 const* addr)
 {
-  sockaddr->sin_port = htons(port);
-
-  auto sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  auto const sock = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
   if (sock < 0) {
-    logger::mdns()->error("Error creating socket: " + getErrnoString());
-    return -1;
+    return false;
   }
 
-  unsigned char ttl = 1;
-  unsigned char loopback = 1;
-  unsigned int reuseaddr = 1;
-
-  if (setsockopt(
-        sock, SOL_SOCKET, SO_REUSEADDR, &reuseaddr, sizeof(reuseaddr)) < 0) {
-    logger::mdns()->error("Error setting SO_REUSEADDR socket option: " +
-                          getErrnoString());
-    ::close(sock);
-    return -1;
-  }
+  auto probe = *addr;
+  probe.sin6_port = 0;
+  bool const tentative =
+    bind(sock, reinterpret_cast<sockaddr*>(&probe), sizeof(probe)) < 0 &&
+    errno == EADDRNOTAVAIL;
 
-#ifdef SO_REUSEPORT
-  if (setsockopt(
-        sock, SOL_SOCKET, SO_REUSEPORT, &reuseaddr, sizeof(reuseaddr)) < 0) {
-    logger::mdns()->error("Error setting SO_REUSEPORT socket option: " +
-                          getErrnoString());
-    ::close(sock);
-    return -1;
-  }
-#endif
-
-  if (setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
-    logger::mdns()->error("Error setting IP_MULTICAST_TTL socket option: " +
-                          getErrnoString());
-    ::close(sock);
-    return -1;
-  }
+  ::close(sock);
+  return tentative;
+}
 
-  if (setsockopt(
-        sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loopback, sizeof(loopback)) < 0) {
-    logger::mdns()->error("Error setting IP_MULTICAST_LOOP socket option: " +
-                          getErrnoString());
-    ::close(sock);
-    return -1;
+template<typename T>
+bool
+setOption(int sock, int level, int name, T value, char const* label)
+{
+  if (setsockopt(sock, level, name, &value, sizeof(value)) < 0) {
+    logger::mdns()->error(std::string("Error setting ") + label +
+                          " socket option: " + getErrnoString());
+    return false;
   }
 
-  sockaddr_in bind_addr = {};
-  bind_addr.sin_family = AF_INET;
-  bind_addr.sin_port = htons(port);
-  bind_addr.sin_addr.s_addr = INADDR_ANY;
+  return true;
+}
 
-  if (bind(sock, reinterpret_cast<::sockaddr*>(&bind_addr), sizeof(bind_addr)) <
-      0) {
-    logger::mdns()->error("Error binding socket: " + getErrnoString());
-    ::close(sock);
-    return -1;
+bool
+setMulticastOptions(int sock, int family)
+{
+  unsigned char const ttl = 1;
+  unsigned char const loopback = 1;
+  unsigned int const hops = 1;
+  unsigned int const loopback6 = 1;
+  int const on = 1;
+
+  // Datagrams carry their kernel receive time, those without one are
+  // stamped when parsed
+  setOption(sock, SOL_SOCKET, SO_TIMESTAMPNS, on, "SO_TIMESTAMPNS");
+
+  if (family == AF_INET6) {
+    return setOption(sock, IPPROTO_IPV6, IPV6_V6ONLY, on, "IPV6_V6ONLY") &&
+           setOption(sock,
+                     IPPROTO_IPV6,
+                     IPV6_MULTICAST_HOPS,
+                     hops,
+                     "IPV6_MULTICAST_HOPS") &&
+           setOption(sock,
+                     IPPROTO_IPV6,
+                     IPV6_MULTICAST_LOOP,
+                     loopback6,
+                     "IPV6_MULTICAST_LOOP") &&
+           setOption(
+             sock, IPPROTO_IPV6, IPV6_RECVPKTINFO, on, "IPV6_RECVPKTINFO");
   }
 
-  ip_mreq req = {};
-  req.imr_multiaddr.s_addr =
-    htonl((((uint32_t)224U) << 24U) | ((uint32_t)251U));
-  req.imr_interface = sockaddr->sin_addr;
+  return setOption(
+           sock, IPPROTO_IP, IP_MULTICAST_TTL, ttl, "IP_MULTICAST_TTL") &&
+         setOption(sock,
+                   IPPROTO_IP,
+                   IP_MULTICAST_LOOP,
+                   loopback,
+                   "IP_MULTICAST_LOOP") &&
+         setOption(sock, IPPROTO_IP, IP_PKTINFO, on, "IP_PKTINFO");
+}
 
-  if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &req, sizeof(req)) < 0) {
-    logger::mdns()->error("Error setting IP_ADD_MEMBERSHIP socket options: " +
-                          getErrnoString());
-    ::close(sock);
-    return -1;
+int
+bindWildcard(int sock, int family, int port)
+{
+  sockaddr_storage bind_addr = {};
+  socklen_t len = sizeof(sockaddr_in);
+
+  if (family == AF_INET6) {
+    auto* addr = reinterpret_cast<sockaddr_in6*>(&bind_addr);
+    addr->sin6_family = AF_INET6;
+    addr->sin6_port = htons(port);
+    addr->sin6_addr = in6addr_any;
+    len = sizeof(sockaddr_in6);
+  } else {
+    auto* addr = reinterpret_cast<sockaddr_in*>(&bind_addr);
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    addr->sin_addr.s_addr = INADDR_ANY;
   }
 
-  auto const flags = fcntl(sock, F_GETFL, 0);
-  fcntl(sock, F_SETFL, flags | O_NONBLOCK);
-  sockaddr->sin_port = htons(port);
-  return sock;
+  return bind(sock, reinterpret_cast<sockaddr*>(&bind_addr), len);
 }
 
+// The shared listener of a family on the mDNS port. It joins the group on
+// every interface, the arrival interface of a datagram comes with
+// IP_PKTINFO or IPV6_PKTINFO.
 int
-initalizeIpv6Socket(ifaddrs* ifa, sockaddr_in6* sockaddr, int port)
+initializeListener(int family)
 {
-  sockaddr->sin6_port = htons(port);
-
-  auto sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+  auto sock = socket(family, SOCK_DGRAM, IPPROTO_UDP);
   if (sock < 0) {
-    logger::mdns()->error("Error creating IPv6 socket: " + getErrnoString());
+    logger::mdns()->error("Error creating socket: " + getErrnoString());
     return -1;
   }
 
-  unsigned int ttl = 1;
-  unsigned int loopback = 1;
-  unsigned int reuseaddr = 1;
+  unsigned int const reuseaddr = 1;
+  [[maybe_unused]] int const off = 0;
 
-  if (setsockopt(
-        sock, SOL_SOCKET, SO_REUSEADDR, &reuseaddr, sizeof(reuseaddr)) < 0) {
-    logger::mdns()->error("Error setting SO_REUSEADDR socket option: " +
-                          getErrnoString());
+  if (!setOption(
+        sock, SOL_SOCKET, SO_REUSEADDR, reuseaddr, "SO_REUSEADDR") ||
+#ifdef SO_REUSEPORT
+      !setOption(sock, SOL_SOCKET, SO_REUSEPORT, reuseaddr, "SO_REUSEPORT") ||
+#endif
+      !setMulticastOptions(sock, family)) {
     ::close(sock);
     return -1;
   }
 
-#ifdef SO_REUSEPORT
-  if (setsockopt(
-        sock, SOL_SOCKET, SO_REUSEPORT, &reuseaddr, sizeof(reuseaddr)) < 0) {
-    logger::mdns()->error("Error setting SO_REUSEPORT socket option: " +
-                          getErrnoString());
-    ::close(sock);
-    return -1;
+  // Only the groups joined by this socket, not those of other sockets on the
+  // same port
+#if defined(IP_MULTICAST_ALL) && defined(IPV6_MULTICAST_ALL)
+  if (family == AF_INET6) {
+    setOption(
+      sock, IPPROTO_IPV6, IPV6_MULTICAST_ALL, off, "IPV6_MULTICAST_ALL");
+  } else {
+    setOption(sock, IPPROTO_IP, IP_MULTICAST_ALL, off, "IP_MULTICAST_ALL");
   }
 #endif
 
-  int ipv6only = 1;
-  if (setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &ipv6only, sizeof(ipv6only)) <
-      0) {
-    logger::mdns()->error("Error setting IPV6_V6ONLY socket option: " +
-                          getErrnoString());
+  if (bindWildcard(sock, family, mdns::proto::port) < 0) {
+    logger::mdns()->error("Error binding socket: " + getErrnoString());
     ::close(sock);
     return -1;
   }
 
-  if (setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &ttl, sizeof(ttl)) <
-      0) {
-    logger::mdns()->error("Error setting IPV6_MULTICAST_HOPS socket option: " +
-                          getErrnoString());
-    ::close(sock);
-    return -1;
+  auto const flags = fcntl(sock, F_GETFL, 0);
+  fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+  return sock;
+}
+
+bool
+joinGroup(int sock, sockaddr const* iface_addr, unsigned ifindex)
+{
+  if (iface_addr->sa_family == AF_INET6) {
+    ipv6_mreq req = {};
+    req.ipv6mr_multiaddr.s6_addr[0] = 0xff;
+    req.ipv6mr_multiaddr.s6_addr[1] = 0x02;
+    req.ipv6mr_multiaddr.s6_addr[15] = 0xfb;
+    req.ipv6mr_interface = ifindex;
+
+    return setOption(
+      sock, IPPROTO_IPV6, IPV6_JOIN_GROUP, req, "IPV6_JOIN_GROUP");
   }
 
-  if (setsockopt(
-        sock, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &loopback, sizeof(loopback)) <
-      0) {
-    logger::mdns()->error("Error setting IPV6_MULTICAST_LOOP socket option: " +
-                          getErrnoString());
-    ::close(sock);
-    return -1;
+  ip_mreqn req = {};
+  req.imr_multiaddr.s_addr =
+    htonl((((uint32_t)224U) << 24U) | ((uint32_t)251U));
+  req.imr_address =
+    reinterpret_cast<sockaddr_in const*>(iface_addr)->sin_addr;
+  req.imr_ifindex = static_cast<int>(ifindex);
+
+  return setOption(
+    sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, req, "IP_ADD_MEMBERSHIP");
+}
+
+// Fails once the interface is gone, the kernel has dropped the membership
+// with it
+void
+leaveGroup(int sock, int family, unsigned ifindex)
+{
+  if (family == AF_INET6) {
+    ipv6_mreq req = {};
+    req.ipv6mr_multiaddr.s6_addr[0] = 0xff;
+    req.ipv6mr_multiaddr.s6_addr[1] = 0x02;
+    req.ipv6mr_multiaddr.s6_addr[15] = 0xfb;
+    req.ipv6mr_interface = ifindex;
+    setsockopt(sock, IPPROTO_IPV6, IPV6_LEAVE_GROUP, &req, sizeof(req));
+    return;
   }
 
-  ipv6_mreq req = {};
-  req.ipv6mr_multiaddr.s6_addr[0] = 0xff;
-  req.ipv6mr_multiaddr.s6_addr[1] = 0x02;
-  req.ipv6mr_multiaddr.s6_addr[15] = 0xfb;
+  ip_mreqn req = {};
+  req.imr_multiaddr.s_addr =
+    htonl((((uint32_t)224U) << 24U) | ((uint32_t)251U));
+  req.imr_ifindex = static_cast<int>(ifindex);
+  setsockopt(sock, IPPROTO_IP, IP_DROP_MEMBERSHIP, &req, sizeof(req));
+}
 
-  req.ipv6mr_interface = if_nametoindex(ifa->ifa_name);
-  if (setsockopt(sock, IPPROTO_IPV6, IPV6_JOIN_GROUP, &req, sizeof(req)) < 0) {
-    logger::mdns()->error("Error setting IPV6_JOIN_GROUP socket option: " +
-                          getErrnoString());
-    ::close(sock);
+// Notified when a link or an address is added, removed or changes state
+int
+openInterfaceWatcher()
+{
+  auto const sock =
+    socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (sock < 0) {
+    logger::mdns()->warn("Interface changes are not watched: " +
+                         getErrnoString());
     return -1;
   }
 
-  if (bind(sock,
-           reinterpret_cast<::sockaddr*>(sockaddr),
-           sizeof(sockaddr_in6)) < 0) {
-    logger::mdns()->error("Error binding IPv6 socket: " + getErrnoString());
+  sockaddr_nl addr = {};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+
+  if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    logger::mdns()->warn("Interface changes are not watched: " +
+                         getErrnoString());
     ::close(sock);
     return -1;
   }
 
-  auto const flags = fcntl(sock, F_GETFL, 0);
-  fcntl(sock, F_SETFL, flags | O_NONBLOCK);
   return sock;
 }
 
 }
 
+// One listener per family on the mDNS port, which joins the group on every
+// interface of its family and sends their queries. Every datagram is
+// received once, by the listener of its family, whatever the number of
+// interfaces. max bounds the interfaces followed.
 std::vector<mdns::MdnsHelper::sock_fd_t>
 mdns::MdnsHelper::BackendImpl::open_client_sockets_foreach_iface(
   const std::size_t max,
   [[maybe_unused]] int port)
 {
   std::vector<sock_fd_t> result;
-  result.reserve(max);
+  max_interfaces_ = max;
+
+  for (auto const& iface : scan_interfaces()) {
+    if (send_contexts_.size() >= max) {
+      logger::mdns()->warn("Reached max interface count, skipping " +
+                           iface.address);
+      break;
+    }
+
+    open_interface(iface, result);
+  }
 
+  return result;
+}
+
+std::vector<mdns::MdnsHelper::BackendImpl::interface_addr>
+mdns::MdnsHelper::BackendImpl::scan_interfaces()
+{
+  std::vector<interface_addr> result;
   ifaddrs* ifaddr{ nullptr };
   char conv[128];
 
@@ -259,238 +340,836 @@ mdns::MdnsHelper::BackendImpl::open_client_sockets_foreach_iface(
   }
 
   for (ifaddrs* curr_if = ifaddr; curr_if; curr_if = curr_if->ifa_next) {
-    if (!curr_if->ifa_addr) {
+    if (!curr_if->ifa_addr || (curr_if->ifa_flags & IFF_UP) == 0) {
       continue;
     }
 
-    if (result.size() >= max) {
-      logger::mdns()->warn(
-        "Reached max sockets count. Unable to create socket");
-      break;
-    }
+    interface_addr iface;
+    iface.family = curr_if->ifa_addr->sa_family;
 
-    if (curr_if->ifa_addr->sa_family == AF_INET) {
+    if (iface.family == AF_INET) {
       auto* sockaddr = reinterpret_cast<sockaddr_in*>(curr_if->ifa_addr);
 
       if (isLoopback(sockaddr)) {
         continue;
       }
 
-      auto sock = initalizeIpv4Socket(sockaddr, 0);
-      if (sock < 0) {
-        logger::mdns()->warn(
-          "Skipping IPv4 socket: " +
-          inet2str(conv, sizeof(conv), sockaddr, sizeof(sockaddr_in)));
-        continue;
-      }
-
-      logger::mdns()->trace(
-        "Init IPv4 socket: " +
-        inet2str(conv, sizeof(conv), sockaddr, sizeof(sockaddr_in)));
-      result.push_back(std::move(sock));
+      iface.address =
+        inet2str(conv, sizeof(conv), sockaddr, sizeof(sockaddr_in));
+      std::memcpy(&iface.addr, sockaddr, sizeof(sockaddr_in));
+    } else if (iface.family == AF_INET6) {
+      auto* sockaddr = reinterpret_cast<sockaddr_in6*>(curr_if->ifa_addr);
 
-      sock = initalizeIpv4Socket(sockaddr, proto::port);
-      if (sock < 0) {
-        logger::mdns()->warn(
-          "Skipping IPv4 socket: " +
-          inet2str(conv, sizeof(conv), sockaddr, sizeof(sockaddr_in)));
+      if (IN6_IS_ADDR_LOOPBACK(&sockaddr->sin6_addr) ||
+          IN6_IS_ADDR_V4MAPPED(&sockaddr->sin6_addr) ||
+          isTentative(sockaddr)) {
         continue;
       }
 
-      logger::mdns()->trace(
-        "Init IPv4 socket: " +
-        inet2str(conv, sizeof(conv), sockaddr, sizeof(sockaddr_in)));
-      result.push_back(std::move(sock));
+      iface.address =
+        inet2str(conv, sizeof(conv), sockaddr, sizeof(sockaddr_in6));
+      std::memcpy(&iface.addr, sockaddr, sizeof(sockaddr_in6));
+    } else {
+      continue;
     }
 
-    if (curr_if->ifa_addr->sa_family == AF_INET6) {
-      auto* sockaddr = reinterpret_cast<sockaddr_in6*>(curr_if->ifa_addr);
+    // Further addresses of an interface need neither a socket nor a group
+    // membership of their own
+    iface.ifindex = if_nametoindex(curr_if->ifa_name);
+    if (std::ranges::any_of(result, [&](interface_addr const& seen) -> bool {
+          return seen.family == iface.family && seen.ifindex == iface.ifindex;
+        })) {
+      continue;
+    }
 
-      if (IN6_IS_ADDR_LOOPBACK(&sockaddr->sin6_addr) ||
-          IN6_IS_ADDR_V4MAPPED(&sockaddr->sin6_addr)) {
-        continue;
-      }
+    iface.name = curr_if->ifa_name;
+    result.push_back(std::move(iface));
+  }
 
-      auto sock = initalizeIpv6Socket(curr_if, sockaddr, proto::port);
-      if (sock < 0) {
-        logger::mdns()->warn(
-          "Skipping IPv6 socket: " +
-          inet2str(conv, sizeof(conv), sockaddr, sizeof(sockaddr_in)));
-        continue;
-      }
+  freeifaddrs(ifaddr);
+  return result;
+}
 
-      logger::mdns()->trace(
-        "Init IPv6 socket: " +
-        inet2str(conv, sizeof(conv), sockaddr, sizeof(sockaddr_in6)));
-      result.push_back(sock);
+// Joins the group on the interface from the listener of its family, which
+// is opened on first use and appended to sockets. False when the interface
+// has no listener to send from.
+bool
+mdns::MdnsHelper::BackendImpl::open_interface(interface_addr const& iface,
+                                              std::vector<sock_fd_t>& sockets)
+{
+  auto const* addr = reinterpret_cast<sockaddr const*>(&iface.addr);
+  auto& family_listener = listener(iface.family);
 
-      sock = initalizeIpv6Socket(curr_if, sockaddr, 0);
-      if (sock < 0) {
-        logger::mdns()->warn(
-          "Skipping IPv6 socket: " +
-          inet2str(conv, sizeof(conv), sockaddr, sizeof(sockaddr_in)));
-        continue;
-      }
+  if (family_listener < 0) {
+    family_listener = initializeListener(iface.family);
 
-      logger::mdns()->trace(
-        "Init IPv6 socket: " +
-        inet2str(conv, sizeof(conv), sockaddr, sizeof(sockaddr_in6)));
-      result.push_back(sock);
+    if (family_listener < 0) {
+      logger::mdns()->warn("Skipping interface without listener: " +
+                           iface.address);
+      return false;
     }
+
+    logger::mdns()->trace(std::string("Init listener socket: ") +
+                          (iface.family == AF_INET ? "IPv4" : "IPv6"));
+    sockets.push_back(family_listener);
   }
 
-  freeifaddrs(ifaddr);
-  return result;
+  if (joinGroup(family_listener, addr, iface.ifindex)) {
+    logger::mdns()->trace("Joined group on " + iface.name + ": " +
+                          iface.address);
+  }
+
+  add_send_context(iface.family, addr, iface.ifindex);
+  return true;
 }
 
-int
-mdns::MdnsHelper::BackendImpl::send_multicast(sock_fd_t sock,
-                                              void const* buffer,
-                                              std::size_t size)
+std::vector<mdns::MdnsHelper::BackendImpl::send_target>
+mdns::MdnsHelper::BackendImpl::update_interfaces(
+  std::vector<sock_fd_t>& sockets)
 {
-  sockaddr_storage addr_storage;
-  sockaddr_in addr;
-  sockaddr_in6 addr6;
-  sockaddr* saddr = reinterpret_cast<struct sockaddr*>(&addr_storage);
+  auto const current = scan_interfaces();
+  std::vector<send_target> added;
+
+  // An IPv4 interface that changed its address is reopened, the source
+  // address of its queries is pinned
+  std::vector<send_context> gone;
+  for (auto const& context : send_contexts_) {
+    auto const present =
+      std::ranges::any_of(current, [&](interface_addr const& iface) -> bool {
+        return iface.family == context.family &&
+               iface.ifindex == context.ifindex &&
+               (iface.family == AF_INET6 ||
+                std::memcmp(&iface.addr, &context.local, sizeof(sockaddr_in)) ==
+                  0);
+      });
+
+    if (!present) {
+      gone.push_back(context);
+    }
+  }
 
-  socklen_t saddrlen = sizeof(struct sockaddr_storage);
-  if (getsockname(sock, saddr, &saddrlen)) {
-    logger::mdns()->error("getsockname() failed: " + getErrnoString());
-    return -1;
+  for (auto const& context : gone) {
+    logger::mdns()->info("Interface {} gone from {}",
+                         context.ifindex,
+                         context.family == AF_INET ? "IPv4" : "IPv6");
+
+    if (auto const sock = listener(context.family); sock >= 0) {
+      leaveGroup(sock, context.family, context.ifindex);
+    }
+
+    std::erase_if(send_contexts_, [&](send_context const& c) -> bool {
+      return c.family == context.family && c.ifindex == context.ifindex;
+    });
   }
 
-  if (saddr->sa_family == AF_INET6) {
-    memset(&addr6, 0, sizeof(addr6));
-    addr6.sin6_family = AF_INET6;
+  for (auto const& iface : current) {
+    if (std::ranges::any_of(
+          send_contexts_, [&](send_context const& context) -> bool {
+            return context.family == iface.family &&
+                   context.ifindex == iface.ifindex;
+          })) {
+      continue;
+    }
+
+    if (send_contexts_.size() >= max_interfaces_) {
+      logger::mdns()->warn("Reached max interface count, skipping " +
+                           iface.address);
+      break;
+    }
+
+    logger::mdns()->info("Interface {} up: {}", iface.name, iface.address);
+
+    auto const first_new = sockets.size();
+    auto const opened = open_interface(iface, sockets);
+
+    for (auto i = first_new; i < sockets.size(); ++i) {
+      sockets_.push_back(sockets[i]);
+      watch_socket(sockets[i]);
+    }
+
+    if (opened) {
+      added.push_back({ iface.family, iface.ifindex });
+    }
+  }
+
+  if (!gone.empty() || !added.empty()) {
+    fanout_stale_ = true;
+    refresh_fanout();
+  }
+
+  return added;
+}
+
+mdns::proto::mdns_endpoint
+mdns::MdnsHelper::BackendImpl::to_endpoint(sockaddr_storage const& addr)
+{
+  proto::mdns_endpoint endpoint;
+
+  if (addr.ss_family == AF_INET) {
+    auto const* a = reinterpret_cast<sockaddr_in const*>(&addr);
+    std::memcpy(endpoint.address.data(), &a->sin_addr, sizeof(a->sin_addr));
+    endpoint.port = ntohs(a->sin_port);
+  } else if (addr.ss_family == AF_INET6) {
+    auto const* a = reinterpret_cast<sockaddr_in6 const*>(&addr);
+    std::memcpy(endpoint.address.data(), &a->sin6_addr, sizeof(a->sin6_addr));
+    endpoint.ipv6 = true;
+    endpoint.port = ntohs(a->sin6_port);
+    endpoint.scope_id = a->sin6_scope_id;
+  }
+
+  return endpoint;
+}
+
+// mDNS group address of the family
+socklen_t
+mdns::MdnsHelper::BackendImpl::multicast_group(int family,
+                                               sockaddr_storage& addr)
+{
+  addr = {};
+
+  if (family == AF_INET6) {
+    auto* addr6 = reinterpret_cast<sockaddr_in6*>(&addr);
+    addr6->sin6_family = AF_INET6;
 
 #ifdef __APPLE__
-    addr6.sin6_len = sizeof(addr6);
+    addr6->sin6_len = sizeof(sockaddr_in6);
 #endif
 
-    addr6.sin6_addr.s6_addr[0] = 0xFF;
-    addr6.sin6_addr.s6_addr[1] = 0x02;
-    addr6.sin6_addr.s6_addr[15] = 0xFB;
-    addr6.sin6_port = htons(static_cast<unsigned short>(proto::port));
+    addr6->sin6_addr.s6_addr[0] = 0xFF;
+    addr6->sin6_addr.s6_addr[1] = 0x02;
+    addr6->sin6_addr.s6_addr[15] = 0xFB;
+    addr6->sin6_port = htons(static_cast<unsigned short>(proto::port));
+    return sizeof(sockaddr_in6);
+  }
 
-    saddr = reinterpret_cast<sockaddr*>(&addr6);
-    saddrlen = sizeof(addr6);
-  } else {
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
+  auto* addr4 = reinterpret_cast<sockaddr_in*>(&addr);
+  addr4->sin_family = AF_INET;
 
 #ifdef __APPLE__
-    addr.sin_len = sizeof(addr);
+  addr4->sin_len = sizeof(sockaddr_in);
 #endif
 
-    addr.sin_addr.s_addr = htonl((((uint32_t)224U) << 24U) | ((uint32_t)251U));
-    addr.sin_port = htons(static_cast<unsigned short>(proto::port));
-    saddr = reinterpret_cast<struct sockaddr*>(&addr);
-    saddrlen = sizeof(addr);
+  addr4->sin_addr.s_addr = htonl((((uint32_t)224U) << 24U) | ((uint32_t)251U));
+  addr4->sin_port = htons(static_cast<unsigned short>(proto::port));
+  return sizeof(sockaddr_in);
+}
+
+mdns::MdnsHelper::BackendImpl::clock_pair
+mdns::MdnsHelper::BackendImpl::clock_pair::now()
+{
+  return { std::chrono::system_clock::now(),
+           std::chrono::steady_clock::now() };
+}
+
+// Arrival interface and kernel receive time of a datagram
+void
+mdns::MdnsHelper::BackendImpl::read_control(msghdr const& hdr,
+                                            clock_pair const& clocks,
+                                            proto::mdns_recv_res& recv_res)
+{
+  for (auto* cmsg = CMSG_FIRSTHDR(&hdr); cmsg;
+       cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&hdr), cmsg)) {
+    if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO) {
+      in_pktinfo info;
+      std::memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+      recv_res.ifindex = static_cast<std::uint32_t>(info.ipi_ifindex);
+    } else if (cmsg->cmsg_level == IPPROTO_IPV6 &&
+               cmsg->cmsg_type == IPV6_PKTINFO) {
+      in6_pktinfo info;
+      std::memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+      recv_res.ifindex = info.ipi6_ifindex;
+    } else if (cmsg->cmsg_level == SOL_SOCKET &&
+               cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+      timespec ts;
+      std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+
+      // A wall clock step can put the stamp ahead of the batch, the packet
+      // is never younger than that
+      auto const age = std::max(
+        clocks.wall.time_since_epoch() -
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::seconds(ts.tv_sec) +
+            std::chrono::nanoseconds(ts.tv_nsec)),
+        std::chrono::system_clock::duration::zero());
+      recv_res.time_of_arrival =
+        clocks.steady -
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(age);
+    }
+  }
+}
+
+// Outgoing interface and source address of a message, returns the control
+// length
+std::size_t
+mdns::MdnsHelper::BackendImpl::pktinfo(send_context const& context,
+                                       std::uint8_t* control)
+{
+  auto* cmsg = reinterpret_cast<cmsghdr*>(control);
+
+  if (context.family == AF_INET6) {
+    // The source address is left to the kernel, it prefers the link-local
+    // address of the interface for ff02::fb
+    in6_pktinfo info{};
+    info.ipi6_ifindex = context.ifindex;
+
+    cmsg->cmsg_level = IPPROTO_IPV6;
+    cmsg->cmsg_type = IPV6_PKTINFO;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(info));
+    std::memcpy(CMSG_DATA(cmsg), &info, sizeof(info));
+    return CMSG_SPACE(sizeof(info));
+  }
+
+  in_pktinfo info{};
+  info.ipi_ifindex = static_cast<int>(context.ifindex);
+  info.ipi_spec_dst =
+    reinterpret_cast<sockaddr_in const*>(&context.local)->sin_addr;
+
+  cmsg->cmsg_level = IPPROTO_IP;
+  cmsg->cmsg_type = IP_PKTINFO;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(info));
+  std::memcpy(CMSG_DATA(cmsg), &info, sizeof(info));
+  return CMSG_SPACE(sizeof(info));
+}
+
+void
+mdns::MdnsHelper::BackendImpl::add_send_context(int family,
+                                                sockaddr const* local,
+                                                unsigned ifindex)
+{
+  send_context context;
+  context.family = family;
+  context.ifindex = ifindex;
+
+  if (family == AF_INET6) {
+    std::memcpy(&context.local, local, sizeof(sockaddr_in6));
+    reinterpret_cast<sockaddr_in6*>(&context.local)->sin6_port = 0;
+  } else {
+    std::memcpy(&context.local, local, sizeof(sockaddr_in));
+    reinterpret_cast<sockaddr_in*>(&context.local)->sin_port = 0;
+  }
+
+  send_contexts_.push_back(context);
+}
+
+mdns::MdnsHelper::BackendImpl::send_context const*
+mdns::MdnsHelper::BackendImpl::find_send_context(
+  send_target const& target) const
+{
+  auto const it =
+    std::ranges::find_if(send_contexts_, [&](send_context const& c) -> bool {
+      return c.family == target.family && c.ifindex == target.ifindex;
+    });
+  return it != send_contexts_.end() ? &*it : nullptr;
+}
+
+mdns::MdnsHelper::sock_fd_t&
+mdns::MdnsHelper::BackendImpl::listener(int family)
+{
+  return family == AF_INET6 ? listener_ipv6_ : listener_ipv4_;
+}
+
+// One message per interface and family, sent through the listener of the
+// family. Queries from the mDNS port get multicast replies, which reach the
+// listener once.
+void
+mdns::MdnsHelper::BackendImpl::build_fanout()
+{
+  fanout_.clear();
+
+  for (auto const family : { AF_INET, AF_INET6 }) {
+    fanout_family fanout;
+    fanout.sock = listener(family);
+
+    for (auto const& context : send_contexts_) {
+      if (context.family != family) {
+        continue;
+      }
+
+      auto& message = fanout.messages.emplace_back();
+      auto& header = fanout.headers.emplace_back();
+      header.msg_hdr.msg_controllen = pktinfo(context, message.control.data());
+    }
+
+    if (fanout.sock >= 0 && !fanout.messages.empty()) {
+      multicast_group(family, fanout.group);
+      fanout_.push_back(std::move(fanout));
+    }
   }
 
-  if (sendto(sock, buffer, static_cast<int>(size), 0, saddr, saddrlen) < 0) {
-    logger::mdns()->error("sendto() failed: " + getErrnoString());
+  // The headers point into the messages, which no longer move
+  for (auto& fanout : fanout_) {
+    auto const group_len = fanout.group.ss_family == AF_INET6
+                             ? sizeof(sockaddr_in6)
+                             : sizeof(sockaddr_in);
+
+    for (std::size_t i = 0; i < fanout.messages.size(); ++i) {
+      auto& hdr = fanout.headers[i].msg_hdr;
+      hdr.msg_name = &fanout.group;
+      hdr.msg_namelen = group_len;
+      hdr.msg_iov = &fanout.messages[i].iov;
+      hdr.msg_iovlen = 1;
+      hdr.msg_control = fanout.messages[i].control.data();
+    }
+  }
+}
+
+// The messages of a query still in flight belong to the kernel until it
+// completes
+void
+mdns::MdnsHelper::BackendImpl::refresh_fanout()
+{
+  if (fanout_stale_ && !(uring_ && uring_->sending())) {
+    build_fanout();
+    fanout_stale_ = false;
+  }
+}
+
+void
+mdns::MdnsHelper::BackendImpl::set_fanout_payload(fanout_family& fanout,
+                                                  void const* buffer,
+                                                  std::size_t size)
+{
+  for (auto& message : fanout.messages) {
+    message.iov = { const_cast<void*>(buffer), size };
+  }
+}
+
+// Sent from the listener of the family like the fan-out, replies to the
+// mDNS port are multicast
+int
+mdns::MdnsHelper::BackendImpl::send_multicast(send_target const& target,
+                                              void const* buffer,
+                                              std::size_t size)
+{
+  auto const* context = find_send_context(target);
+  auto const sock = listener(target.family);
+  if (!context || sock < 0) {
+    logger::mdns()->error("No listener for interface: " +
+                          std::to_string(target.ifindex));
+    return -1;
+  }
+
+  sockaddr_storage group;
+  fanout_message message;
+  message.iov = { const_cast<void*>(buffer), size };
+
+  msghdr hdr{};
+  hdr.msg_name = &group;
+  hdr.msg_namelen = multicast_group(context->family, group);
+  hdr.msg_iov = &message.iov;
+  hdr.msg_iovlen = 1;
+  hdr.msg_control = message.control.data();
+  hdr.msg_controllen = pktinfo(*context, message.control.data());
+
+  if (sendmsg(sock, &hdr, 0) < 0) {
+    logger::mdns()->error("sendmsg() failed: " + getErrnoString());
     return -1;
   }
 
   return 0;
 }
 
-mdns::MdnsHelper::BackendImpl::BackendImpl() = default;
-mdns::MdnsHelper::BackendImpl::~BackendImpl() = default;
+bool
+mdns::MdnsHelper::BackendImpl::send_multicast_all(
+  std::span<std::vector<std::uint8_t> const> ipv4,
+  std::span<std::vector<std::uint8_t> const> ipv6)
+{
+  refresh_fanout();
+
+  if (uring_) {
+    return uring_->send(ipv4, ipv6);
+  }
+
+  bool delivered = false;
+
+  for (auto& fanout : fanout_) {
+    auto const packets = fanout.group.ss_family == AF_INET6 ? ipv6 : ipv4;
 
+    for (auto const& packet : packets) {
+      set_fanout_payload(fanout, packet.data(), packet.size());
+      std::size_t sent = 0;
+
+      while (sent < fanout.headers.size()) {
+        auto const ret = sendmmsg(fanout.sock,
+                                  fanout.headers.data() + sent,
+                                  fanout.headers.size() - sent,
+                                  0);
+        if (ret < 0) {
+          logger::mdns()->error("sendmmsg() failed: " + getErrnoString());
+
+          // The message that failed is skipped, the others still go out
+          ++sent;
+          continue;
+        }
+
+        sent += static_cast<std::size_t>(ret);
+        delivered = true;
+      }
+    }
+  }
+
+  return delivered;
+}
+
+// The eventfd lives as long as the backend, wake() may be called from other
+// threads at any time
+mdns::MdnsHelper::BackendImpl::BackendImpl()
+  : event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+  if (event_fd_ < 0) {
+    logger::mdns()->error("Error creating eventfd: " + getErrnoString());
+  }
+}
+
+mdns::MdnsHelper::BackendImpl::~BackendImpl()
+{
+  close_event_loop();
+
+  if (event_fd_ >= 0) {
+    ::close(event_fd_);
+  }
+}
+
+// The interfaces of a listener go with it
 void
 mdns::MdnsHelper::BackendImpl::close(sock_fd_t sock)
 {
+  for (auto const family : { AF_INET, AF_INET6 }) {
+    if (auto& family_listener = listener(family); family_listener == sock) {
+      family_listener = -1;
+      std::erase_if(send_contexts_, [&](send_context const& context) -> bool {
+        return context.family == family;
+      });
+    }
+  }
+
   ::close(sock);
 }
 
-std::vector<mdns::proto::mdns_recv_res>
-mdns::MdnsHelper::BackendImpl::receive_discovery(
-  std::vector<sock_fd_t> const& sockets)
+std::shared_ptr<std::uint8_t[]>
+mdns::MdnsHelper::BackendImpl::acquire_buffer()
+{
+  for (std::size_t i = 0; i < recv_pool_.size(); ++i) {
+    auto const index = (recv_cursor_ + i) % recv_pool_.size();
+
+    if (recv_pool_[index].use_count() == 1) {
+      recv_cursor_ = index + 1;
+      return recv_pool_[index];
+    }
+  }
+
+  // Every pooled buffer is still referenced, the pool grows up to its limit
+  // and falls back to one-off buffers after that
+  auto buffer =
+    std::make_shared_for_overwrite<std::uint8_t[]>(recv_buffer_size);
+
+  if (recv_pool_.size() < recv_pool_limit) {
+    recv_pool_.push_back(buffer);
+  }
+
+  return buffer;
+}
+
+void
+mdns::MdnsHelper::BackendImpl::receive_from(
+  sock_fd_t sock,
+  std::vector<proto::mdns_recv_res>& out)
 {
-  static constexpr std::size_t RECV_BUFF_SIZE = 2048;
+  std::array<std::shared_ptr<std::uint8_t[]>, recv_batch> buffers;
+  std::array<sockaddr_storage, recv_batch> addrs;
+  std::array<iovec, recv_batch> iovs;
+  std::array<mmsghdr, recv_batch> msgs;
+  alignas(cmsghdr) std::uint8_t controls[recv_batch][recv_control_size];
+  std::size_t consumed = recv_batch;
+
+  while (true) {
+    // Buffers handed out in the previous round are replaced, the others are
+    // still unused
+    for (std::size_t i = 0; i < consumed; ++i) {
+      buffers[i] = acquire_buffer();
+    }
+
+    for (std::size_t i = 0; i < recv_batch; ++i) {
+      iovs[i] = { buffers[i].get(), recv_buffer_size };
+      msgs[i] = {};
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_control = controls[i];
+      msgs[i].msg_hdr.msg_controllen = recv_control_size;
+    }
+
+    auto const count =
+      recvmmsg(sock, msgs.data(), recv_batch, MSG_DONTWAIT, nullptr);
+
+    if (count < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        logger::mdns()->error("recvmmsg() failed: " + getErrnoString());
+      }
+
+      break;
+    }
+
+    auto const clocks = clock_pair::now();
 
-  std::vector<proto::mdns_recv_res> result;
-  result.reserve(sockets.size());
+    for (int i = 0; i < count; ++i) {
+      auto const& hdr = msgs[i].msg_hdr;
 
-  timeval timeout{};
-  timeout.tv_sec = 0;
-  timeout.tv_usec = 100000;
+      if (msgs[i].msg_len == 0) {
+        logger::mdns()->warn("Zero-length UDP datagram ignored");
+        continue;
+      }
+
+      if (hdr.msg_flags & MSG_TRUNC) {
+        logger::mdns()->warn("Truncated UDP datagram ignored");
+        continue;
+      }
 
-  fd_set readfs;
-  FD_ZERO(&readfs);
+      proto::mdns_recv_res recv_res;
+      recv_res.source = to_endpoint(addrs[i]);
+      read_control(hdr, clocks, recv_res);
+      recv_res.packet.buffer = buffers[i];
+      recv_res.packet.size = msgs[i].msg_len;
+      out.push_back(std::move(recv_res));
+    }
 
-  int nfds = 0;
-  for (auto socket : sockets) {
-    FD_SET(socket, &readfs);
-    nfds = std::max(nfds, socket + 1);
+    consumed = static_cast<std::size_t>(count);
+    if (consumed < recv_batch) {
+      break;
+    }
   }
+}
 
-  int res = select(nfds, &readfs, nullptr, nullptr, &timeout);
-  if (res < 0) {
-    logger::mdns()->error("select() failed: " + std::string(strerror(errno)));
-    return result;
-  } else if (res == 0) {
-    // logger::mdns()->warn("select() timeout: no responses received");
-    return result;
+bool
+mdns::MdnsHelper::BackendImpl::open_event_loop(
+  std::vector<sock_fd_t> const& sockets)
+{
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+  if (timer_fd_ < 0 || event_fd_ < 0) {
+    logger::mdns()->error("Error creating event loop: " + getErrnoString());
+    close_event_loop();
+    return false;
   }
 
-  char ipStr[INET6_ADDRSTRLEN] = {};
-  uint16_t port = 0;
+  sockets_ = sockets;
+  build_fanout();
+  netlink_fd_ = openInterfaceWatcher();
 
-  for (auto socket : sockets) {
-    if (!FD_ISSET(socket, &readfs)) {
-      continue;
+  uring_ =
+    Uring::create(sockets_, fanout_, timer_fd_, event_fd_, netlink_fd_);
+  if (uring_) {
+    logger::mdns()->info("Using io_uring event loop");
+    return true;
+  }
+
+  return open_epoll();
+}
+
+bool
+mdns::MdnsHelper::BackendImpl::open_epoll()
+{
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+
+  if (epoll_fd_ < 0) {
+    logger::mdns()->error("Error creating event loop: " + getErrnoString());
+    close_event_loop();
+    return false;
+  }
+
+  auto watch = [this](int fd) -> bool {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == 0;
+  };
+
+  if (!watch(timer_fd_) || !watch(event_fd_) ||
+      (netlink_fd_ >= 0 && !watch(netlink_fd_))) {
+    logger::mdns()->error("epoll_ctl() failed: " + getErrnoString());
+    close_event_loop();
+    return false;
+  }
+
+  for (auto const sock : sockets_) {
+    if (!watch(sock)) {
+      logger::mdns()->error("epoll_ctl() failed: " + getErrnoString());
+      close_event_loop();
+      return false;
     }
+  }
 
-    while (true) {
-      char buffer[RECV_BUFF_SIZE];
-
-      sockaddr_storage addr{};
-      socklen_t addrlen = sizeof(addr);
-
-      auto ret = recvfrom(socket,
-                          buffer,
-                          sizeof(buffer),
-                          0,
-                          reinterpret_cast<sockaddr*>(&addr),
-                          &addrlen);
-      if (ret > 0) {
-        if (addr.ss_family == AF_INET) {
-          auto* a = reinterpret_cast<sockaddr_in*>(&addr);
-          inet_ntop(AF_INET, &a->sin_addr, ipStr, sizeof(ipStr));
-          port = ntohs(a->sin_port);
-        } else if (addr.ss_family == AF_INET6) {
-          auto* a = reinterpret_cast<sockaddr_in6*>(&addr);
-          inet_ntop(AF_INET6, &a->sin6_addr, ipStr, sizeof(ipStr));
-          port = ntohs(a->sin6_port);
-        }
+  logger::mdns()->info("Using epoll event loop");
+  return true;
+}
+
+void
+mdns::MdnsHelper::BackendImpl::watch_socket(sock_fd_t sock)
+{
+  if (uring_) {
+    uring_->add_socket(sock);
+    return;
+  }
+
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = sock;
 
-        proto::mdns_recv_res recv_res;
-        recv_res.ip_addr_str = ipStr;
-        recv_res.port = port;
-        recv_res.blob = std::vector<char>(buffer, buffer + ret);
-        result.push_back(recv_res);
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, sock, &event) < 0) {
+    logger::mdns()->error("epoll_ctl() failed: " + getErrnoString());
+  }
+}
 
+// Drains the pending notifications, true when one of them concerns links
+// or addresses
+bool
+mdns::MdnsHelper::BackendImpl::read_interface_events()
+{
+  alignas(nlmsghdr) std::uint8_t buffer[8192];
+  bool changed = false;
+
+  while (true) {
+    auto const len = recv(netlink_fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+    if (len < 0) {
+      // The socket overflowed, whatever was lost is found by the rescan
+      if (errno == ENOBUFS) {
+        changed = true;
         continue;
       }
 
-      if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-        break;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        logger::mdns()->error("netlink recv() failed: " + getErrnoString());
       }
 
-      if (ret == 0) {
-        logger::mdns()->warn("Zero-length UDP datagram ignored");
-        break;
+      break;
+    }
+
+    auto remaining = static_cast<int>(len);
+    for (auto* hdr = reinterpret_cast<nlmsghdr*>(buffer);
+         NLMSG_OK(hdr, remaining);
+         hdr = NLMSG_NEXT(hdr, remaining)) {
+      switch (hdr->nlmsg_type) {
+        case RTM_NEWLINK:
+        case RTM_DELLINK:
+        case RTM_NEWADDR:
+        case RTM_DELADDR:
+          changed = true;
+          break;
+        default:
+          break;
       }
+    }
+  }
 
-      logger::mdns()->error("recvfrom() failed: " + getErrnoString());
-      break;
+  return changed;
+}
+
+void
+mdns::MdnsHelper::BackendImpl::arm_query_timer(
+  std::chrono::steady_clock::time_point due)
+{
+  // steady_clock is CLOCK_MONOTONIC, the deadline is passed as it is. A zero
+  // it_value would disarm the timer instead.
+  auto const since_epoch = due.time_since_epoch();
+  auto const sec =
+    std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+
+  itimerspec spec{};
+  spec.it_value = { static_cast<time_t>(sec.count()),
+                    static_cast<long>(
+                      std::chrono::nanoseconds(since_epoch - sec).count()) };
+  if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+    spec.it_value.tv_nsec = 1;
+  }
+
+  if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+    logger::mdns()->error("timerfd_settime() failed: " + getErrnoString());
+  }
+}
+
+mdns::MdnsHelper::BackendImpl::events
+mdns::MdnsHelper::BackendImpl::wait_events(
+  std::vector<proto::mdns_recv_res>& out)
+{
+  static constexpr int max_events = 32;
+
+  if (uring_) {
+    auto result = uring_->wait(out);
+
+    // Kernels before 6.0 accept the buffer ring but reject multishot
+    // receives on first use
+    if (uring_->unsupported()) {
+      logger::mdns()->info("io_uring lacks multishot receives, using epoll");
+      uring_.reset();
+      open_epoll();
+    }
+
+    if (result.interfaces_changed) {
+      result.interfaces_changed = read_interface_events();
+    }
+
+    return result;
+  }
+
+  events result;
+  epoll_event ready[max_events];
+
+  auto const count = epoll_wait(epoll_fd_, ready, max_events, -1);
+  if (count < 0) {
+    if (errno != EINTR) {
+      logger::mdns()->error("epoll_wait() failed: " + getErrnoString());
+    }
+
+    return result;
+  }
+
+  for (int i = 0; i < count; ++i) {
+    auto const fd = ready[i].data.fd;
+    std::uint64_t counter = 0;
+
+    if (fd == timer_fd_) {
+      result.query_due = read(timer_fd_, &counter, sizeof(counter)) > 0;
+    } else if (fd == event_fd_) {
+      result.woken = read(event_fd_, &counter, sizeof(counter)) > 0;
+    } else if (fd == netlink_fd_) {
+      result.interfaces_changed = read_interface_events();
+    } else {
+      receive_from(fd, out);
     }
   }
 
   return result;
 }
 
+void
+mdns::MdnsHelper::BackendImpl::wake()
+{
+  if (event_fd_ < 0) {
+    return;
+  }
+
+  std::uint64_t const one = 1;
+  if (write(event_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    logger::mdns()->error("Error waking event loop: " + getErrnoString());
+  }
+}
+
+void
+mdns::MdnsHelper::BackendImpl::close_event_loop()
+{
+  uring_.reset();
+  sockets_.clear();
+  fanout_.clear();
+  fanout_stale_ = false;
+
+  for (auto* fd : { &epoll_fd_, &timer_fd_, &netlink_fd_ }) {
+    if (*fd >= 0) {
+      ::close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
 #endif // WIN32
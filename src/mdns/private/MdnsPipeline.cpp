@@ -0,0 +1,192 @@
+#include "MdnsPipeline.hpp"
+#include "Logger.h"
+#include <algorithm>
+#include <iterator>
+
+mdns::MdnsHelper::ParsePipeline::ParsePipeline(MdnsHelper& helper,
+                                               std::size_t threads,
+                                               std::function<void()> on_ready)
+  : helper_(helper)
+  , on_ready_(std::move(on_ready))
+{
+  for (std::size_t i = 0; i < threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+
+  for (std::size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back(
+      [this, i](std::stop_token const& stop_token) { run(stop_token, i); });
+  }
+
+  logger::mdns()->info("Parsing on {} threads", threads);
+}
+
+mdns::MdnsHelper::ParsePipeline::~ParsePipeline()
+{
+  for (auto& thread : threads_) {
+    thread.request_stop();
+  }
+
+  // Sleeping workers only look at the stop request once the count moves
+  queued_.fetch_add(1, std::memory_order_release);
+  queued_.notify_all();
+
+  threads_.clear();
+}
+
+void
+mdns::MdnsHelper::ParsePipeline::submit(
+  std::vector<proto::mdns_recv_res>&& messages)
+{
+  for (auto begin = messages.begin(); begin != messages.end();) {
+    auto const end =
+      begin + std::min(static_cast<std::ptrdiff_t>(chunk_size),
+                       messages.end() - begin);
+
+    Job job;
+    job.messages.assign(std::make_move_iterator(begin),
+                        std::make_move_iterator(end));
+    begin = end;
+
+    {
+      std::lock_guard lock(done_mutex_);
+      job.sequence = submitted_++;
+    }
+
+    auto& worker = *workers_[next_worker_];
+    next_worker_ = (next_worker_ + 1) % workers_.size();
+
+    {
+      std::lock_guard lock(worker.mutex);
+      worker.jobs.push_back(std::move(job));
+    }
+
+    queued_.fetch_add(1, std::memory_order_release);
+    queued_.notify_one();
+  }
+}
+
+void
+mdns::MdnsHelper::ParsePipeline::wait_idle()
+{
+  std::unique_lock lock(done_mutex_);
+  idle_.wait(lock, [this] { return completed_ == submitted_; });
+}
+
+void
+mdns::MdnsHelper::ParsePipeline::run(std::stop_token const& stop_token,
+                                     std::size_t self)
+{
+  Job job;
+
+  while (!stop_token.stop_requested()) {
+    if (take(self, job)) {
+      std::unique_ptr<proto::mdns_batch> batch;
+      {
+        std::lock_guard lock(done_mutex_);
+        if (!free_batches_.empty()) {
+          batch = std::move(free_batches_.back());
+          free_batches_.pop_back();
+        }
+      }
+
+      if (!batch) {
+        batch = std::make_unique<proto::mdns_batch>();
+      }
+
+      helper_.parseMessages(job.messages, *batch, helper_.active_filter_);
+
+      // Releases the received buffers before the chunk is handed back
+      auto const sequence = job.sequence;
+      job = Job{};
+      complete(sequence, std::move(batch));
+      continue;
+    }
+
+    // A job counted but not yet visible in a queue is picked up shortly
+    if (queued_.load(std::memory_order_acquire) != 0) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    queued_.wait(0, std::memory_order_acquire);
+  }
+}
+
+bool
+mdns::MdnsHelper::ParsePipeline::take(std::size_t self, Job& job)
+{
+  // The own queue is worked from the front, in arrival order, others are
+  // robbed from the back
+  for (std::size_t i = 0; i < workers_.size(); ++i) {
+    auto& worker = *workers_[(self + i) % workers_.size()];
+    std::lock_guard lock(worker.mutex);
+
+    if (worker.jobs.empty()) {
+      continue;
+    }
+
+    if (i == 0) {
+      job = std::move(worker.jobs.front());
+      worker.jobs.pop_front();
+    } else {
+      job = std::move(worker.jobs.back());
+      worker.jobs.pop_back();
+    }
+
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  return false;
+}
+
+void
+mdns::MdnsHelper::ParsePipeline::complete(
+  std::uint64_t sequence,
+  std::unique_ptr<proto::mdns_batch> batch)
+{
+  bool next = false;
+  bool idle = false;
+  {
+    std::lock_guard lock(done_mutex_);
+    done_.emplace(sequence, std::move(batch));
+    ++completed_;
+    next = sequence == next_delivery_;
+    idle = completed_ == submitted_;
+  }
+
+  if (idle) {
+    idle_.notify_all();
+  }
+
+  if (next) {
+    on_ready_();
+  }
+}
+
+std::optional<std::unique_ptr<mdns::proto::mdns_batch>>
+mdns::MdnsHelper::ParsePipeline::next_ready()
+{
+  std::lock_guard lock(done_mutex_);
+
+  auto const it = done_.begin();
+  if (it == done_.end() || it->first != next_delivery_) {
+    return std::nullopt;
+  }
+
+  auto batch = std::move(it->second);
+  done_.erase(it);
+  ++next_delivery_;
+  return batch;
+}
+
+void
+mdns::MdnsHelper::ParsePipeline::recycle(
+  std::unique_ptr<proto::mdns_batch> batch)
+{
+  batch->clear();
+
+  std::lock_guard lock(done_mutex_);
+  free_batches_.push_back(std::move(batch));
+}
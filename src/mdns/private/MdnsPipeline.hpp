@@ -0,0 +1,98 @@
+#ifndef MDNSPIPELINE_HPP
+#define MDNSPIPELINE_HPP
+
+#include "MdnsHelper.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Parses received messages on a pool of worker threads while the browsing
+// thread keeps receiving. Messages are cut into chunks numbered in arrival
+// order and dealt round-robin to the workers' queues, a worker that runs dry
+// steals from the others. Parsed chunks are handed back in sequence order,
+// so the service store sees responses in the order they were received.
+//
+// The workers read the helper's active filter and query packet, the
+// browsing thread waits for the pool to go idle before changing either.
+struct mdns::MdnsHelper::ParsePipeline
+{
+  // on_ready is called from a worker when the next chunk in sequence has
+  // been parsed
+  ParsePipeline(MdnsHelper& helper,
+                std::size_t threads,
+                std::function<void()> on_ready);
+  ~ParsePipeline();
+
+  ParsePipeline(ParsePipeline const&) = delete;
+  ParsePipeline& operator=(ParsePipeline const&) = delete;
+
+  // Browsing thread only
+  void submit(std::vector<proto::mdns_recv_res>&& messages);
+  void wait_idle();
+
+  // Browsing thread only. Hands every parsed chunk that is next in sequence
+  // to fn, empty ones are skipped.
+  template<typename F>
+  void deliver(F&& fn)
+  {
+    while (auto batch = next_ready()) {
+      if (!(*batch)->responses.empty()) {
+        fn(**batch);
+      }
+      recycle(std::move(batch.value()));
+    }
+  }
+
+private:
+  // Packets per chunk, the size of a receive batch of the backend
+  static constexpr std::size_t chunk_size = 16;
+
+  struct Job
+  {
+    std::uint64_t sequence = 0;
+    std::vector<proto::mdns_recv_res> messages;
+  };
+
+  struct Worker
+  {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  void run(std::stop_token const& stop_token, std::size_t self);
+  // Moves the next job into job, false when every queue is empty
+  bool take(std::size_t self, Job& job);
+  void complete(std::uint64_t sequence,
+                std::unique_ptr<proto::mdns_batch> batch);
+  std::optional<std::unique_ptr<proto::mdns_batch>> next_ready();
+  void recycle(std::unique_ptr<proto::mdns_batch> batch);
+
+  MdnsHelper& helper_;
+  std::function<void()> on_ready_;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::jthread> threads_;
+  std::size_t next_worker_ = 0;
+
+  // Jobs waiting in any queue, the workers sleep on it while it is zero
+  std::atomic<std::size_t> queued_{ 0 };
+
+  // Guards everything below
+  std::mutex done_mutex_;
+  std::condition_variable idle_;
+  std::map<std::uint64_t, std::unique_ptr<proto::mdns_batch>> done_;
+  std::vector<std::unique_ptr<proto::mdns_batch>> free_batches_;
+  std::uint64_t submitted_ = 0;
+  std::uint64_t completed_ = 0;
+  std::uint64_t next_delivery_ = 0;
+};
+
+#endif // MDNSPIPELINE_HPP
@@ -0,0 +1,609 @@
+#ifndef WIN32
+
+#include "MdnsUringImpl.hpp"
+#include "../include/Proto.h"
+#include <Logger.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// Raw system calls, liburing is not required
+int
+ioUringSetup(unsigned entries, io_uring_params* params)
+{
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int
+ioUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+  auto const ret = syscall(
+    __NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+  return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+int
+ioUringRegister(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+  auto const ret = syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+  return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+std::string
+errnoString(int err)
+{
+  auto* str = strerror(err);
+  return str ? str : "";
+}
+
+template<typename E>
+std::uint64_t
+userData(E kind, std::size_t index)
+{
+  return (static_cast<std::uint64_t>(kind) << 32U) | index;
+}
+
+}
+
+std::unique_ptr<mdns::MdnsHelper::BackendImpl::Uring>
+mdns::MdnsHelper::BackendImpl::Uring::create(
+  std::vector<sock_fd_t> const& sockets,
+  std::vector<fanout_family>& fanout,
+  int timer_fd,
+  int event_fd,
+  int netlink_fd)
+{
+  std::unique_ptr<Uring> uring(new Uring);
+  uring->sockets_ = sockets;
+  uring->fanout_ = &fanout;
+  uring->recv_armed_.assign(sockets.size(), false);
+  uring->timer_fd_ = timer_fd;
+  uring->event_fd_ = event_fd;
+  uring->netlink_fd_ = netlink_fd;
+
+  // Room for a receive and a send per socket plus the polls, more requests
+  // are submitted early
+  auto const entries = std::bit_ceil(
+    std::max<std::size_t>(sockets.size() * 2 + 3, buffer_count / 4));
+
+  io_uring_params params{};
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL |
+                 IORING_SETUP_COOP_TASKRUN;
+  params.cq_entries = std::max<unsigned>(cq_entries, entries * 2);
+
+  uring->ring_fd_ = ioUringSetup(static_cast<unsigned>(entries), &params);
+  if (uring->ring_fd_ < 0) {
+    logger::mdns()->info("io_uring unavailable: " + errnoString(errno));
+    return nullptr;
+  }
+
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 ||
+      (params.features & IORING_FEAT_NODROP) == 0) {
+    logger::mdns()->info("io_uring lacks required features");
+    return nullptr;
+  }
+
+  if (!uring->map_rings(params) || !uring->register_buffers()) {
+    return nullptr;
+  }
+
+  uring->recv_msg_.msg_namelen = sizeof(sockaddr_storage);
+  uring->recv_msg_.msg_controllen = recv_control_size;
+
+  uring->arm_poll(timer_fd, op::poll_timer);
+  uring->arm_poll(event_fd, op::poll_event);
+  if (netlink_fd >= 0) {
+    uring->arm_poll(netlink_fd, op::poll_netlink);
+  }
+  for (std::size_t i = 0; i < sockets.size(); ++i) {
+    uring->arm_recv(i);
+  }
+
+  if (auto const ret = uring->enter(0); ret < 0) {
+    logger::mdns()->info("io_uring_enter() failed: " + errnoString(-ret));
+    return nullptr;
+  }
+
+  return uring;
+}
+
+mdns::MdnsHelper::BackendImpl::Uring::~Uring()
+{
+  // The kernel writes into the provided buffers until every receive is
+  // cancelled, closing the ring alone does not wait for that
+  if (active_ > 0) {
+    if (auto* sqe = get_sqe()) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->fd = -1;
+      sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+      sqe->user_data = userData(op::cancel, 0);
+      ++active_;
+    }
+  }
+
+  while (active_ > 0) {
+    if (auto const ret = enter(1); ret < 0 && ret != -EINTR) {
+      logger::mdns()->error("io_uring_enter() failed: " + errnoString(-ret));
+      break;
+    }
+
+    auto head = *cq_head_;
+    auto const tail =
+      std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+
+    for (; head != tail; ++head) {
+      if ((cqes_[head & cq_mask_].flags & IORING_CQE_F_MORE) == 0) {
+        --active_;
+      }
+    }
+
+    std::atomic_ref(*cq_head_).store(head, std::memory_order_release);
+  }
+
+  if (buf_ring_) {
+    munmap(buf_ring_, buffer_count * sizeof(io_uring_buf));
+  }
+
+  if (sqes_) {
+    munmap(sqes_, sqes_size_);
+  }
+
+  if (sq_ring_) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+
+  if (ring_fd_ >= 0) {
+    ::close(ring_fd_);
+  }
+}
+
+bool
+mdns::MdnsHelper::BackendImpl::Uring::map_rings(io_uring_params const& params)
+{
+  // With IORING_FEAT_SINGLE_MMAP both rings share one mapping
+  sq_ring_size_ = std::max(
+    params.sq_off.array + params.sq_entries * sizeof(unsigned),
+    params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+
+  sq_ring_ = mmap(nullptr,
+                  sq_ring_size_,
+                  PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE,
+                  ring_fd_,
+                  IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    sq_ring_ = nullptr;
+    logger::mdns()->info("io_uring ring mmap() failed: " +
+                         errnoString(errno));
+    return false;
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  auto* sqes = mmap(nullptr,
+                    sqes_size_,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE,
+                    ring_fd_,
+                    IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    logger::mdns()->info("io_uring SQE mmap() failed: " + errnoString(errno));
+    return false;
+  }
+
+  auto* sq = static_cast<std::uint8_t*>(sq_ring_);
+  sqes_ = static_cast<io_uring_sqe*>(sqes);
+  sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_local_tail_ = *sq_tail_;
+
+  cq_ring_ = sq_ring_;
+  auto* cq = static_cast<std::uint8_t*>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  return true;
+}
+
+bool
+mdns::MdnsHelper::BackendImpl::Uring::register_buffers()
+{
+  auto const ring_size = buffer_count * sizeof(io_uring_buf);
+  auto* ring = mmap(nullptr,
+                    ring_size,
+                    PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1,
+                    0);
+  if (ring == MAP_FAILED) {
+    logger::mdns()->info("io_uring buffer ring mmap() failed: " +
+                         errnoString(errno));
+    return false;
+  }
+
+  buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+
+  io_uring_buf_reg reg{};
+  reg.ring_addr = reinterpret_cast<std::uint64_t>(ring);
+  reg.ring_entries = buffer_count;
+  reg.bgid = buffer_group;
+
+  if (auto const ret =
+        ioUringRegister(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1);
+      ret < 0) {
+    logger::mdns()->info("io_uring buffer ring unavailable: " +
+                         errnoString(-ret));
+    return false;
+  }
+
+  buffers_.reserve(buffer_count);
+  for (std::uint16_t bid = 0; bid < buffer_count; ++bid) {
+    buffers_.push_back(
+      std::make_shared_for_overwrite<std::uint8_t[]>(buffer_size));
+    provide_buffer(bid);
+  }
+
+  std::atomic_ref(buf_ring_->tail).store(buf_tail_, std::memory_order_release);
+  return true;
+}
+
+io_uring_sqe*
+mdns::MdnsHelper::BackendImpl::Uring::get_sqe()
+{
+  auto head = std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+
+  if (sq_local_tail_ - head >= sq_entries_) {
+    // The queue is full, its requests go to the kernel right away
+    if (auto const ret = enter(0); ret < 0) {
+      logger::mdns()->error("io_uring_enter() failed: " + errnoString(-ret));
+      return nullptr;
+    }
+
+    head = std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+    if (sq_local_tail_ - head >= sq_entries_) {
+      return nullptr;
+    }
+  }
+
+  auto const index = sq_local_tail_ & sq_mask_;
+  auto* sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sq_array_[index] = index;
+  ++sq_local_tail_;
+  return sqe;
+}
+
+int
+mdns::MdnsHelper::BackendImpl::Uring::enter(unsigned min_complete)
+{
+  std::atomic_ref(*sq_tail_).store(sq_local_tail_, std::memory_order_release);
+
+  auto const to_submit =
+    sq_local_tail_ - std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+
+  if (to_submit == 0 && min_complete == 0) {
+    return 0;
+  }
+
+  return ioUringEnter(ring_fd_,
+                      to_submit,
+                      min_complete,
+                      min_complete > 0 ? IORING_ENTER_GETEVENTS : 0);
+}
+
+void
+mdns::MdnsHelper::BackendImpl::Uring::arm_recv(std::size_t index)
+{
+  auto* sqe = get_sqe();
+  if (!sqe) {
+    return;
+  }
+
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = sockets_[index];
+  sqe->addr = reinterpret_cast<std::uint64_t>(&recv_msg_);
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = buffer_group;
+  sqe->user_data = userData(op::recv, index);
+
+  recv_armed_[index] = true;
+  ++active_;
+}
+
+void
+mdns::MdnsHelper::BackendImpl::Uring::arm_poll(int fd, op kind)
+{
+  auto* sqe = get_sqe();
+  if (!sqe) {
+    return;
+  }
+
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = POLLIN;
+  sqe->len = IORING_POLL_ADD_MULTI;
+  sqe->user_data = userData(kind, 0);
+  ++active_;
+}
+
+void
+mdns::MdnsHelper::BackendImpl::Uring::provide_buffer(std::uint16_t bid)
+{
+  // Entry 0 overlaps the ring tail, only the fields around it are written.
+  // The bufs member is not used, the empty struct in front of the flexible
+  // array moves it by 8 bytes in C++.
+  auto* bufs = reinterpret_cast<io_uring_buf*>(buf_ring_);
+  auto& entry = bufs[buf_tail_ & (buffer_count - 1)];
+  entry.addr = reinterpret_cast<std::uint64_t>(buffers_[bid].get());
+  entry.len = buffer_size;
+  entry.bid = bid;
+  ++buf_tail_;
+}
+
+void
+mdns::MdnsHelper::BackendImpl::Uring::recycle_buffers()
+{
+  for (auto const bid : lent_) {
+    // Still referenced by a packet view kept past the previous round, a
+    // fresh buffer takes its place in the ring
+    if (buffers_[bid].use_count() != 1) {
+      buffers_[bid] =
+        std::make_shared_for_overwrite<std::uint8_t[]>(buffer_size);
+    }
+
+    provide_buffer(bid);
+  }
+
+  if (!lent_.empty()) {
+    lent_.clear();
+    std::atomic_ref(buf_ring_->tail)
+      .store(buf_tail_, std::memory_order_release);
+  }
+
+  // Receives stop when the ring runs dry, they resume with the buffers back
+  for (std::size_t i = 0; i < sockets_.size(); ++i) {
+    if (sockets_[i] >= 0 && !recv_armed_[i]) {
+      arm_recv(i);
+    }
+  }
+}
+
+void
+mdns::MdnsHelper::BackendImpl::Uring::on_recv(
+  io_uring_cqe const& cqe,
+  clock_pair const& clocks,
+  std::vector<proto::mdns_recv_res>& out)
+{
+  auto const index = static_cast<std::size_t>(cqe.user_data & 0xFFFFFFFFU);
+
+  if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+    recv_armed_[index] = false;
+  }
+
+  if (cqe.res < 0) {
+    if (cqe.res == -EINVAL && !recv_seen_) {
+      unsupported_ = true;
+    } else if (cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+      logger::mdns()->error("io_uring receive failed: " +
+                            errnoString(-cqe.res));
+    }
+
+    return;
+  }
+
+  recv_seen_ = true;
+
+  if ((cqe.flags & IORING_CQE_F_BUFFER) == 0) {
+    return;
+  }
+
+  auto const bid =
+    static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+  auto const& buffer = buffers_[bid];
+  lent_.push_back(bid);
+
+  io_uring_recvmsg_out header;
+  std::memcpy(&header, buffer.get(), sizeof(header));
+
+  auto const length = static_cast<std::size_t>(cqe.res);
+  if (length < payload_offset || header.payloadlen > length - payload_offset) {
+    logger::mdns()->warn("Malformed io_uring receive ignored");
+    return;
+  }
+
+  if (header.payloadlen == 0) {
+    logger::mdns()->warn("Zero-length UDP datagram ignored");
+    return;
+  }
+
+  if (header.flags & MSG_TRUNC) {
+    logger::mdns()->warn("Truncated UDP datagram ignored");
+    return;
+  }
+
+  sockaddr_storage addr{};
+  std::memcpy(&addr,
+              buffer.get() + sizeof(io_uring_recvmsg_out),
+              std::min<std::size_t>(header.namelen, sizeof(addr)));
+
+  msghdr control{};
+  control.msg_control = buffer.get() + control_offset;
+  control.msg_controllen =
+    std::min<std::size_t>(header.controllen, recv_control_size);
+
+  proto::mdns_recv_res recv_res;
+  recv_res.source = to_endpoint(addr);
+  read_control(control, clocks, recv_res);
+  recv_res.packet.buffer = std::shared_ptr<std::uint8_t const[]>(
+    buffer, buffer.get() + payload_offset);
+  recv_res.packet.size = header.payloadlen;
+  out.push_back(std::move(recv_res));
+}
+
+mdns::MdnsHelper::BackendImpl::events
+mdns::MdnsHelper::BackendImpl::Uring::wait(
+  std::vector<proto::mdns_recv_res>& out)
+{
+  events result;
+  recycle_buffers();
+
+  if (auto const ret = enter(1); ret < 0) {
+    if (ret != -EINTR) {
+      logger::mdns()->error("io_uring_enter() failed: " + errnoString(-ret));
+    }
+
+    return result;
+  }
+
+  auto head = *cq_head_;
+  auto const tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+  auto const clocks = clock_pair::now();
+
+  for (; head != tail; ++head) {
+    auto const& cqe = cqes_[head & cq_mask_];
+    auto const kind = static_cast<op>(cqe.user_data >> 32U);
+    bool const more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+    std::uint64_t counter = 0;
+
+    if (!more) {
+      --active_;
+    }
+
+    switch (kind) {
+      case op::recv:
+        on_recv(cqe, clocks, out);
+        break;
+      case op::poll_timer:
+        result.query_due = read(timer_fd_, &counter, sizeof(counter)) > 0;
+        if (!more) {
+          arm_poll(timer_fd_, op::poll_timer);
+        }
+        break;
+      case op::poll_event:
+        result.woken = read(event_fd_, &counter, sizeof(counter)) > 0;
+        if (!more) {
+          arm_poll(event_fd_, op::poll_event);
+        }
+        break;
+      case op::poll_netlink:
+        // The backend drains the socket
+        result.interfaces_changed = true;
+        if (!more) {
+          arm_poll(netlink_fd_, op::poll_netlink);
+        }
+        break;
+      case op::send:
+        --sends_in_flight_;
+        if (cqe.res < 0) {
+          logger::mdns()->error("io_uring send failed: " +
+                                errnoString(-cqe.res));
+        }
+        // The next datagram of the query is submitted with the next enter
+        submit_send();
+        break;
+      case op::cancel:
+        break;
+    }
+  }
+
+  std::atomic_ref(*cq_head_).store(head, std::memory_order_release);
+  return result;
+}
+
+bool
+mdns::MdnsHelper::BackendImpl::Uring::send(
+  std::span<std::vector<std::uint8_t> const> ipv4,
+  std::span<std::vector<std::uint8_t> const> ipv6)
+{
+  // The caller's packets may change before the sends complete. A query
+  // sent while another is in flight waits behind it.
+  bool queued = false;
+  auto const queue = [&](int family,
+                         std::span<std::vector<std::uint8_t> const> packets) {
+    if (std::ranges::none_of(*fanout_, [&](fanout_family const& fanout) {
+          return fanout.group.ss_family == family && !fanout.headers.empty();
+        })) {
+      return;
+    }
+
+    for (auto const& packet : packets) {
+      send_queue_.push_back({ family, packet });
+      queued = true;
+    }
+  };
+
+  queue(AF_INET, ipv4);
+  queue(AF_INET6, ipv6);
+  submit_send();
+
+  if (auto const ret = enter(0); ret < 0) {
+    logger::mdns()->error("io_uring_enter() failed: " + errnoString(-ret));
+    return false;
+  }
+
+  return queued;
+}
+
+void
+mdns::MdnsHelper::BackendImpl::Uring::submit_send()
+{
+  // A datagram nothing could be queued for is skipped, the next one would
+  // otherwise wait for a completion that never comes
+  while (sends_in_flight_ == 0 && !send_queue_.empty()) {
+    send_data_ = std::move(send_queue_.front());
+    send_queue_.pop_front();
+
+    for (auto& fanout : *fanout_) {
+      if (fanout.group.ss_family != send_data_.family) {
+        continue;
+      }
+
+      for (std::size_t i = 0; i < fanout.headers.size(); ++i) {
+        auto* sqe = get_sqe();
+        if (!sqe) {
+          break;
+        }
+
+        fanout.messages[i].iov = { send_data_.data.data(),
+                                   send_data_.data.size() };
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fanout.sock;
+        sqe->addr =
+          reinterpret_cast<std::uint64_t>(&fanout.headers[i].msg_hdr);
+        sqe->len = 1;
+        sqe->user_data = userData(op::send, i);
+
+        ++sends_in_flight_;
+        ++active_;
+      }
+    }
+  }
+}
+
+void
+mdns::MdnsHelper::BackendImpl::Uring::add_socket(sock_fd_t sock)
+{
+  sockets_.push_back(sock);
+  recv_armed_.push_back(false);
+  arm_recv(sockets_.size() - 1);
+
+  if (auto const ret = enter(0); ret < 0) {
+    logger::mdns()->error("io_uring_enter() failed: " + errnoString(-ret));
+  }
+}
+
+#endif // WIN32
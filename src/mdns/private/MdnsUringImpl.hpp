@@ -0,0 +1,142 @@
+#ifndef MDNSURINGIMPL_HPP
+#define MDNSURINGIMPL_HPP
+
+#ifndef WIN32
+
+#include "MdnsImpl.hpp"
+#include <cstdint>
+#include <deque>
+#include <linux/io_uring.h>
+#include <memory>
+#include <span>
+#include <sys/socket.h>
+#include <vector>
+
+// io_uring event loop of the Linux backend. Every socket keeps a multishot
+// receive running that draws from a ring of provided buffers, the timerfd,
+// eventfd and netlink socket are watched by multishot polls and the messages
+// of a query fan-out go out with a single submission.
+struct mdns::MdnsHelper::BackendImpl::Uring
+{
+  // Null when the kernel has no io_uring, it is disabled or it lacks
+  // provided buffer rings (5.19). A negative netlink_fd is not watched.
+  static std::unique_ptr<Uring> create(std::vector<sock_fd_t> const& sockets,
+                                       std::vector<fanout_family>& fanout,
+                                       int timer_fd,
+                                       int event_fd,
+                                       int netlink_fd);
+
+  ~Uring();
+
+  events wait(std::vector<proto::mdns_recv_res>& out);
+
+  // Queues the datagrams of a query behind those still in flight, whose
+  // messages the kernel owns until they complete. Datagrams go out one
+  // after the other, each once the sends of the one before completed, and
+  // only on the fan-out of their family. False when no fan-out takes any of
+  // them.
+  bool send(std::span<std::vector<std::uint8_t> const> ipv4,
+            std::span<std::vector<std::uint8_t> const> ipv6);
+  bool sending() const
+  {
+    return sends_in_flight_ > 0 || !send_queue_.empty();
+  }
+
+  // Sockets of interfaces that come up while the loop runs
+  void add_socket(sock_fd_t sock);
+
+  // Set when the kernel rejected the multishot receives
+  bool unsupported() const { return unsupported_; }
+
+private:
+  enum class op : std::uint32_t
+  {
+    recv,
+    poll_timer,
+    poll_event,
+    poll_netlink,
+    send,
+    cancel,
+  };
+
+  static constexpr unsigned cq_entries = 256;
+  static constexpr std::uint16_t buffer_count = 64;
+  static constexpr std::uint16_t buffer_group = 0;
+
+  // The kernel writes an io_uring_recvmsg_out header, the source address
+  // and the control messages in front of the payload
+  static constexpr std::size_t control_offset =
+    sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage);
+  static constexpr std::size_t payload_offset =
+    control_offset + recv_control_size;
+  static constexpr std::size_t buffer_size = payload_offset + recv_buffer_size;
+
+  Uring() = default;
+
+  bool map_rings(io_uring_params const& params);
+  bool register_buffers();
+  io_uring_sqe* get_sqe();
+  int enter(unsigned min_complete);
+  void arm_recv(std::size_t index);
+  void arm_poll(int fd, op kind);
+  void provide_buffer(std::uint16_t bid);
+  void recycle_buffers();
+  void submit_send();
+  void on_recv(io_uring_cqe const& cqe,
+               clock_pair const& clocks,
+               std::vector<proto::mdns_recv_res>& out);
+
+  int ring_fd_ = -1;
+
+  void* sq_ring_ = nullptr;
+  std::size_t sq_ring_size_ = 0;
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned sq_entries_ = 0;
+  unsigned sq_local_tail_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  std::size_t sqes_size_ = 0;
+
+  void* cq_ring_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+
+  // Buffers are handed to the kernel through the ring and lent to packet
+  // views once filled. They are provided again on the next wait, or
+  // replaced when a view still references them.
+  io_uring_buf_ring* buf_ring_ = nullptr;
+  std::uint16_t buf_tail_ = 0;
+  std::vector<std::shared_ptr<std::uint8_t[]>> buffers_;
+  std::vector<std::uint16_t> lent_;
+
+  std::vector<sock_fd_t> sockets_;
+  std::vector<bool> recv_armed_;
+  msghdr recv_msg_{};
+  int timer_fd_ = -1;
+  int event_fd_ = -1;
+  int netlink_fd_ = -1;
+
+  // Messages of the backend's fan-out, submitted as one sendmsg each
+  std::vector<fanout_family>* fanout_ = nullptr;
+  struct datagram
+  {
+    int family = AF_UNSPEC;
+    std::vector<std::uint8_t> data;
+  };
+  datagram send_data_;
+  std::deque<datagram> send_queue_;
+  std::size_t sends_in_flight_ = 0;
+
+  // Requests that will still post a completion, drained on destruction
+  std::size_t active_ = 0;
+  bool recv_seen_ = false;
+  bool unsupported_ = false;
+};
+
+#endif // WIN32
+
+#endif // MDNSURINGIMPL_HPP
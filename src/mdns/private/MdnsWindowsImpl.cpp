@@ -13,6 +13,9 @@
 #include <MdnsImpl.hpp>
 #include <Proto.h>
 
+#include <algorithm>
+#include <cstring>
+
 namespace {
 
 std::string
@@ -115,10 +118,23 @@ mdns::MdnsHelper::BackendImpl::BackendImpl()
 {
   WSADATA wsaData;
   WSAStartup(MAKEWORD(2, 2), &wsaData);
+
+  // Lives as long as the backend, wake() may be called from other threads
+  wake_event_ = WSACreateEvent();
+  if (wake_event_ == WSA_INVALID_EVENT) {
+    logger::mdns()->error("WSACreateEvent() failed: " + winError());
+    wake_event_ = nullptr;
+  }
 }
 
 mdns::MdnsHelper::BackendImpl::~BackendImpl()
 {
+  close_event_loop();
+
+  if (wake_event_) {
+    WSACloseEvent(wake_event_);
+  }
+
   WSACleanup();
 }
 
@@ -187,9 +203,9 @@ mdns::MdnsHelper::BackendImpl::open_client_sockets_foreach_iface(
 }
 
 int
-mdns::MdnsHelper::BackendImpl::send_multicast(sock_fd_t sock,
-                                              void const* buffer,
-                                              std::size_t size)
+mdns::MdnsHelper::BackendImpl::send_to_group(sock_fd_t sock,
+                                             void const* buffer,
+                                             std::size_t size)
 {
   sockaddr_storage addr{};
   socklen_t len = sizeof(addr);
@@ -221,66 +237,189 @@ mdns::MdnsHelper::BackendImpl::send_multicast(sock_fd_t sock,
   return 0;
 }
 
-std::vector<mdns::proto::mdns_recv_res>
-mdns::MdnsHelper::BackendImpl::receive_discovery(
-  std::vector<sock_fd_t> const& sockets)
+bool
+mdns::MdnsHelper::BackendImpl::send_multicast_all(
+  std::span<std::vector<std::uint8_t> const> ipv4,
+  std::span<std::vector<std::uint8_t> const> ipv6)
 {
-  std::vector<proto::mdns_recv_res> result;
+  bool delivered = false;
 
-  timeval timeout{};
-  timeout.tv_sec = 0;
-  timeout.tv_usec = 100000;
+  for (auto s : sockets_) {
+    sockaddr_storage addr{};
+    socklen_t len = sizeof(addr);
+    getsockname(s, (sockaddr*)&addr, &len);
 
-  fd_set readfs;
-  FD_ZERO(&readfs);
+    for (auto const& packet : addr.ss_family == AF_INET6 ? ipv6 : ipv4) {
+      delivered |= send_to_group(s, packet.data(), packet.size()) == 0;
+    }
+  }
 
-  for (auto s : sockets) {
-    FD_SET(s, &readfs);
+  return delivered;
+}
+
+// Sockets are bound per address here, every one of the target family sends
+int
+mdns::MdnsHelper::BackendImpl::send_multicast(send_target const& target,
+                                              void const* buffer,
+                                              std::size_t size)
+{
+  int result = -1;
+
+  for (auto s : sockets_) {
+    sockaddr_storage addr{};
+    socklen_t len = sizeof(addr);
+    getsockname(s, (sockaddr*)&addr, &len);
+
+    if (addr.ss_family == target.family &&
+        send_to_group(s, buffer, size) == 0) {
+      result = 0;
+    }
   }
 
-  int res = select(0, &readfs, nullptr, nullptr, &timeout);
-  if (res <= 0) {
-    return result;
+  return result;
+}
+
+// Interface changes are not watched here, wait_events never reports one
+std::vector<mdns::MdnsHelper::BackendImpl::send_target>
+mdns::MdnsHelper::BackendImpl::update_interfaces(
+  [[maybe_unused]] std::vector<sock_fd_t>& sockets)
+{
+  return {};
+}
+
+void
+mdns::MdnsHelper::BackendImpl::receive_from(
+  sock_fd_t s,
+  std::vector<proto::mdns_recv_res>& out)
+{
+  // No batched receive on Windows, each datagram is copied into a packet
+  // buffer of its own
+  while (true) {
+    char buf[recv_buffer_size];
+    sockaddr_storage addr{};
+    socklen_t len = sizeof(addr);
+
+    int ret = recvfrom(s, buf, sizeof(buf), 0, (sockaddr*)&addr, &len);
+    if (ret <= 0) {
+      break;
+    }
+
+    proto::mdns_recv_res r;
+    if (addr.ss_family == AF_INET) {
+      auto* a = (sockaddr_in*)&addr;
+      std::memcpy(r.source.address.data(), &a->sin_addr, sizeof(a->sin_addr));
+      r.source.port = ntohs(a->sin_port);
+    } else {
+      auto* a = (sockaddr_in6*)&addr;
+      std::memcpy(
+        r.source.address.data(), &a->sin6_addr, sizeof(a->sin6_addr));
+      r.source.ipv6 = true;
+      r.source.port = ntohs(a->sin6_port);
+      r.source.scope_id = a->sin6_scope_id;
+    }
+
+    r.packet = proto::mdns_packet_view::copy_of(buf, ret);
+    out.push_back(std::move(r));
+  }
+}
+
+bool
+mdns::MdnsHelper::BackendImpl::open_event_loop(
+  std::vector<sock_fd_t> const& sockets)
+{
+  // Every socket signals the same event, it is reset before the sockets are
+  // drained so no datagram is missed
+  recv_event_ = WSACreateEvent();
+  if (recv_event_ == WSA_INVALID_EVENT) {
+    logger::mdns()->error("WSACreateEvent() failed: " + winError());
+    recv_event_ = nullptr;
+    return false;
   }
 
-  char ip[INET6_ADDRSTRLEN];
   for (auto s : sockets) {
-    if (!FD_ISSET(s, &readfs)) {
-      continue;
+    if (WSAEventSelect(s, recv_event_, FD_READ) == SOCKET_ERROR) {
+      logger::mdns()->error("WSAEventSelect() failed: " + winError());
+      close_event_loop();
+      return false;
     }
+  }
 
-    while (true) {
-      char buf[2048];
-      sockaddr_storage addr{};
-      socklen_t len = sizeof(addr);
+  sockets_ = sockets;
+  return true;
+}
 
-      int ret = recvfrom(s, buf, sizeof(buf), 0, (sockaddr*)&addr, &len);
-      if (ret <= 0) {
-        break;
-      }
+void
+mdns::MdnsHelper::BackendImpl::arm_query_timer(
+  std::chrono::steady_clock::time_point due)
+{
+  next_query_ = due;
+}
 
-      uint16_t port = 0;
-      if (addr.ss_family == AF_INET) {
-        auto* a = (sockaddr_in*)&addr;
-        inet_ntop(AF_INET, &a->sin_addr, ip, sizeof(ip));
-        port = ntohs(a->sin_port);
-      } else {
-        auto* a = (sockaddr_in6*)&addr;
-        inet_ntop(AF_INET6, &a->sin6_addr, ip, sizeof(ip));
-        port = ntohs(a->sin6_port);
-      }
+mdns::MdnsHelper::BackendImpl::events
+mdns::MdnsHelper::BackendImpl::wait_events(
+  std::vector<proto::mdns_recv_res>& out)
+{
+  events result;
+
+  // Rounded up, a wait that ends early would find the query not yet due
+  DWORD timeout = WSA_INFINITE;
+  if (next_query_ != std::chrono::steady_clock::time_point::max()) {
+    auto const until_query = std::chrono::ceil<std::chrono::milliseconds>(
+      next_query_ - std::chrono::steady_clock::now());
+    timeout = static_cast<DWORD>(
+      std::clamp<std::int64_t>(until_query.count(), 0, WSA_INFINITE - 1));
+  }
+
+  WSAEVENT const handles[] = { recv_event_, wake_event_ };
+  auto const ret = WSAWaitForMultipleEvents(2, handles, FALSE, timeout, FALSE);
+
+  if (ret == WSA_WAIT_FAILED) {
+    logger::mdns()->error("WSAWaitForMultipleEvents() failed: " + winError());
+    return result;
+  }
+
+  if (ret == WSA_WAIT_EVENT_0) {
+    WSAResetEvent(recv_event_);
 
-      proto::mdns_recv_res r;
-      r.ip_addr_str = ip;
-      r.port = port;
-      r.blob.assign(buf, buf + ret);
-      result.push_back(std::move(r));
+    for (auto s : sockets_) {
+      receive_from(s, out);
     }
+  } else if (ret == WSA_WAIT_EVENT_0 + 1) {
+    WSAResetEvent(wake_event_);
+    result.woken = true;
+  }
+
+  if (auto const now = std::chrono::steady_clock::now(); now >= next_query_) {
+    result.query_due = true;
+    next_query_ = std::chrono::steady_clock::time_point::max();
   }
 
   return result;
 }
 
+void
+mdns::MdnsHelper::BackendImpl::wake()
+{
+  if (wake_event_) {
+    WSASetEvent(wake_event_);
+  }
+}
+
+void
+mdns::MdnsHelper::BackendImpl::close_event_loop()
+{
+  for (auto s : sockets_) {
+    WSAEventSelect(s, nullptr, 0);
+  }
+
+  sockets_.clear();
+
+  if (recv_event_) {
+    WSACloseEvent(recv_event_);
+    recv_event_ = nullptr;
+  }
+}
+
 void
 mdns::MdnsHelper::BackendImpl::close(sock_fd_t sock)
 {
@@ -0,0 +1,97 @@
+#include "NameCompressor.h"
+#include <Proto.h>
+#include <algorithm>
+
+namespace {
+
+// Offsets a compression pointer can hold
+constexpr std::size_t max_offset = 0x3FFF;
+constexpr std::uint16_t pointer_mark = 0xC000;
+
+std::string_view
+trimDot(std::string_view name)
+{
+  while (!name.empty() && name.back() == '.') {
+    name.remove_suffix(1);
+  }
+
+  return name;
+}
+
+}
+
+std::pair<std::size_t, std::uint16_t>
+mdns::NameCompressor::match(std::string_view name) const
+{
+  name = trimDot(name);
+
+  for (std::size_t start = 0; start < name.size();) {
+    if (auto const it = suffixes_.find(name.substr(start));
+        it != suffixes_.end()) {
+      return { start, it->second };
+    }
+
+    auto const dot = name.find('.', start);
+    if (dot == std::string_view::npos) {
+      break;
+    }
+    start = dot + 1;
+  }
+
+  return { std::string_view::npos, 0 };
+}
+
+std::size_t
+mdns::NameCompressor::size(std::string_view name) const
+{
+  auto const [prefix, offset] = match(name);
+
+  if (prefix == std::string_view::npos) {
+    return proto::mdns_encoded_name_size(name);
+  }
+
+  // The labels without their root, then the pointer
+  return proto::mdns_encoded_name_size(name.substr(0, prefix)) - 1 +
+         sizeof(pointer_mark);
+}
+
+void
+mdns::NameCompressor::write(std::string_view name,
+                            std::vector<std::uint8_t>& message)
+{
+  name = trimDot(name);
+  auto const [prefix, offset] = match(name);
+  auto const written = prefix != std::string_view::npos ? prefix : name.size();
+
+  for (std::size_t start = 0; start < written;) {
+    auto const dot = name.find('.', start);
+    auto const end = dot == std::string_view::npos ? name.size() : dot;
+
+    if (end > start) {
+      // Every suffix that starts here can be pointed at by later names
+      if (message.size() <= max_offset) {
+        suffixes_.try_emplace(std::string(name.substr(start)),
+                              static_cast<std::uint16_t>(message.size()));
+      }
+
+      message.push_back(static_cast<std::uint8_t>(end - start));
+      std::ranges::copy(name.substr(start, end - start),
+                        std::back_inserter(message));
+    }
+
+    start = end + 1;
+  }
+
+  if (prefix != std::string_view::npos) {
+    proto::mdns_encode_u16(static_cast<std::uint16_t>(pointer_mark | offset),
+                           std::back_inserter(message));
+  } else {
+    message.push_back(0x00);
+  }
+}
+
+void
+mdns::NameCompressor::clear()
+{
+  suffixes_.clear();
+}
@@ -0,0 +1,306 @@
+#include "NameFold.h"
+
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MDNS_NAME_FOLD_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 is picked at runtime, which needs per-function target attributes
+#if defined(MDNS_NAME_FOLD_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define MDNS_NAME_FOLD_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr std::uint64_t ones = 0x0101010101010101ULL;
+constexpr std::uint64_t hash_seed = 0xcbf29ce484222325ULL;
+constexpr std::uint64_t hash_multiplier = 0x9e3779b97f4a7c15ULL;
+
+std::uint64_t
+load(const char* data, std::size_t size)
+{
+  std::uint64_t word = 0;
+  std::memcpy(&word, data, size);
+  return word;
+}
+
+// Adds 0x20 to every byte in 'A'..'Z' without leaving the register: the
+// high bit of each byte is set by the two additions only for bytes at or
+// above 'A' and not above 'Z'
+std::uint64_t
+foldWord(std::uint64_t word)
+{
+  auto const low = word & (0x7f * ones);
+  auto const from_a = low + (0x80 - 'A') * ones;
+  auto const above_z = low + (0x7f - 'Z') * ones;
+  auto const upper = ~word & from_a & ~above_z & (0x80 * ones);
+  return word | (upper >> 2);
+}
+
+std::uint64_t
+mix(std::uint64_t hash, std::uint64_t word)
+{
+  hash = (hash ^ word) * hash_multiplier;
+  return hash ^ (hash >> 29);
+}
+
+bool
+equalsScalar(const char* lhs, const char* rhs, std::size_t size)
+{
+  for (; size >= 8; lhs += 8, rhs += 8, size -= 8) {
+    if (foldWord(load(lhs, 8)) != foldWord(load(rhs, 8))) {
+      return false;
+    }
+  }
+
+  return foldWord(load(lhs, size)) == foldWord(load(rhs, size));
+}
+
+std::uint64_t
+hashScalar(std::uint64_t hash, const char* data, std::size_t size)
+{
+  for (; size >= 8; data += 8, size -= 8) {
+    hash = mix(hash, foldWord(load(data, 8)));
+  }
+
+  if (size > 0) {
+    hash = mix(hash, foldWord(load(data, size)));
+  }
+
+  return hash;
+}
+
+std::size_t
+findScalar(std::string_view haystack, std::string_view needle, std::size_t pos)
+{
+  for (; pos + needle.size() <= haystack.size(); ++pos) {
+    if (equalsScalar(haystack.data() + pos, needle.data(), needle.size())) {
+      return pos;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
+#if defined(MDNS_NAME_FOLD_SSE2)
+
+// Same as foldWord: bytes in 'A'..'Z' land in [-128, -103] after the shift,
+// one signed compare selects exactly them
+__m128i
+fold(__m128i bytes)
+{
+  auto const shifted =
+    _mm_add_epi8(bytes, _mm_set1_epi8(static_cast<char>(0x80 - 'A')));
+  auto const upper =
+    _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(0x80 + 26)));
+  return _mm_or_si128(bytes, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+__m128i
+load128(const char* data)
+{
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+}
+
+bool
+equalsSse2(const char* lhs, const char* rhs, std::size_t size)
+{
+  for (; size >= 16; lhs += 16, rhs += 16, size -= 16) {
+    auto const eq = _mm_cmpeq_epi8(fold(load128(lhs)), fold(load128(rhs)));
+    if (_mm_movemask_epi8(eq) != 0xffff) {
+      return false;
+    }
+  }
+
+  return equalsScalar(lhs, rhs, size);
+}
+
+std::uint64_t
+hashSse2(const char* data, std::size_t size)
+{
+  auto hash = hash_seed;
+
+  for (; size >= 16; data += 16, size -= 16) {
+    alignas(16) std::uint64_t words[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(words), fold(load128(data)));
+    hash = mix(mix(hash, words[0]), words[1]);
+  }
+
+  return hashScalar(hash, data, size);
+}
+
+std::size_t
+findSse2(std::string_view haystack, std::string_view needle)
+{
+  auto const first =
+    _mm_set1_epi8(static_cast<char>(foldWord(load(needle.data(), 1))));
+  auto const last = haystack.size() - needle.size();
+  std::size_t pos = 0;
+
+  // Candidates are the positions whose byte matches the first needle byte,
+  // the rest of the needle is only compared at those
+  for (; pos <= last && pos + 16 <= haystack.size(); pos += 16) {
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(
+      _mm_cmpeq_epi8(fold(load128(haystack.data() + pos)), first)));
+
+    while (mask != 0) {
+      auto const candidate = pos + std::countr_zero(mask);
+      if (candidate > last) {
+        return std::string_view::npos;
+      }
+
+      if (equalsSse2(
+            haystack.data() + candidate, needle.data(), needle.size())) {
+        return candidate;
+      }
+
+      mask &= mask - 1;
+    }
+  }
+
+  return findScalar(haystack, needle, pos);
+}
+
+#endif
+
+#if defined(MDNS_NAME_FOLD_AVX2)
+
+__attribute__((target("avx2"))) __m256i
+fold256(__m256i bytes)
+{
+  auto const shifted =
+    _mm256_add_epi8(bytes, _mm256_set1_epi8(static_cast<char>(0x80 - 'A')));
+  auto const upper =
+    _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(0x80 + 26)), shifted);
+  return _mm256_or_si256(bytes,
+                         _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2"))) __m256i
+load256(const char* data)
+{
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+}
+
+__attribute__((target("avx2"))) bool
+equalsAvx2(const char* lhs, const char* rhs, std::size_t size)
+{
+  for (; size >= 32; lhs += 32, rhs += 32, size -= 32) {
+    auto const eq =
+      _mm256_cmpeq_epi8(fold256(load256(lhs)), fold256(load256(rhs)));
+    if (static_cast<unsigned>(_mm256_movemask_epi8(eq)) != 0xffffffffU) {
+      return false;
+    }
+  }
+
+  // The tail stays in this function: jumping to the legacy SSE encoded
+  // kernel with dirty upper halves costs more than the whole comparison
+  if (size >= 16) {
+    auto const eq = _mm_cmpeq_epi8(fold(load128(lhs)), fold(load128(rhs)));
+    if (_mm_movemask_epi8(eq) != 0xffff) {
+      return false;
+    }
+
+    lhs += 16;
+    rhs += 16;
+    size -= 16;
+  }
+
+  return equalsScalar(lhs, rhs, size);
+}
+
+__attribute__((target("avx2"))) std::uint64_t
+hashAvx2(const char* data, std::size_t size)
+{
+  auto hash = hash_seed;
+
+  for (; size >= 32; data += 32, size -= 32) {
+    alignas(32) std::uint64_t words[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(words),
+                       fold256(load256(data)));
+    hash = mix(mix(mix(mix(hash, words[0]), words[1]), words[2]), words[3]);
+  }
+
+  if (size >= 16) {
+    alignas(16) std::uint64_t words[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(words), fold(load128(data)));
+    hash = mix(mix(hash, words[0]), words[1]);
+    data += 16;
+    size -= 16;
+  }
+
+  return hashScalar(hash, data, size);
+}
+
+#endif
+
+struct Kernels
+{
+  bool (*equals)(const char*, const char*, std::size_t);
+  std::uint64_t (*hash)(const char*, std::size_t);
+  std::size_t (*find)(std::string_view, std::string_view);
+};
+
+Kernels const&
+kernels()
+{
+  static Kernels const selected = []() -> Kernels {
+#if defined(MDNS_NAME_FOLD_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+      return { equalsAvx2, hashAvx2, findSse2 };
+    }
+#endif
+
+#if defined(MDNS_NAME_FOLD_SSE2)
+    return { equalsSse2, hashSse2, findSse2 };
+#else
+    return { equalsScalar,
+             [](const char* data, std::size_t size) -> std::uint64_t {
+               return hashScalar(hash_seed, data, size);
+             },
+             [](std::string_view haystack,
+                std::string_view needle) -> std::size_t {
+               return findScalar(haystack, needle, 0);
+             } };
+#endif
+  }();
+
+  return selected;
+}
+
+}
+
+bool
+mdns::nameEquals(std::string_view lhs, std::string_view rhs)
+{
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+
+  return lhs.empty() || kernels().equals(lhs.data(), rhs.data(), lhs.size());
+}
+
+std::uint64_t
+mdns::nameHash(std::string_view name)
+{
+  return mix(kernels().hash(name.data(), name.size()), name.size());
+}
+
+std::size_t
+mdns::nameFind(std::string_view haystack, std::string_view needle)
+{
+  if (needle.empty()) {
+    return 0;
+  }
+
+  if (needle.size() > haystack.size()) {
+    return std::string_view::npos;
+  }
+
+  return kernels().find(haystack, needle);
+}
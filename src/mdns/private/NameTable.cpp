@@ -0,0 +1,63 @@
+#include "NameTable.h"
+
+#include <mutex>
+
+mdns::proto::mdns_name_id
+mdns::NameTable::intern(std::string_view name)
+{
+  if (name.empty()) {
+    return proto::invalid_name_id;
+  }
+
+  {
+    std::shared_lock lock(mutex_);
+
+    if (auto const it = ids_.find(name); it != ids_.end()) {
+      return it->second;
+    }
+  }
+
+  std::unique_lock lock(mutex_);
+
+  // Another thread may have inserted the name between the two locks
+  if (auto const it = ids_.find(name); it != ids_.end()) {
+    return it->second;
+  }
+
+  auto const id = static_cast<proto::mdns_name_id>(names_.size());
+  auto const& stored = names_.emplace_back(name);
+  ids_.emplace(stored, id);
+
+  return id;
+}
+
+mdns::proto::mdns_name_id
+mdns::NameTable::find(std::string_view name) const
+{
+  std::shared_lock lock(mutex_);
+
+  if (auto const it = ids_.find(name); it != ids_.end()) {
+    return it->second;
+  }
+
+  return proto::invalid_name_id;
+}
+
+std::string const&
+mdns::NameTable::lookup(proto::mdns_name_id id) const
+{
+  std::shared_lock lock(mutex_);
+
+  if (id >= names_.size()) {
+    return names_.front();
+  }
+
+  return names_[id];
+}
+
+std::size_t
+mdns::NameTable::size() const
+{
+  std::shared_lock lock(mutex_);
+  return names_.size() - 1;
+}
@@ -0,0 +1,95 @@
+#include "QueryScheduler.h"
+
+#include <algorithm>
+
+mdns::QueryScheduler::QueryScheduler()
+  : QueryScheduler(Config{})
+{}
+
+mdns::QueryScheduler::QueryScheduler(Config config)
+  : config_(config)
+  , interval_(config.first_interval)
+  , random_(std::random_device{}())
+{}
+
+bool
+mdns::QueryScheduler::requestNow()
+{
+  return !requested_.exchange(true, std::memory_order_acq_rel);
+}
+
+bool
+mdns::QueryScheduler::requestSoon()
+{
+  return !soon_.exchange(true, std::memory_order_acq_rel);
+}
+
+void
+mdns::QueryScheduler::restart(clock::time_point now)
+{
+  requested_.store(false, std::memory_order_relaxed);
+  soon_.store(false, std::memory_order_relaxed);
+  interval_ = config_.first_interval;
+  last_sent_ = {};
+  next_ = now + jitter();
+  backoff_ = next_;
+}
+
+mdns::QueryScheduler::clock::time_point
+mdns::QueryScheduler::next(clock::time_point now)
+{
+  auto const requested = requested_.exchange(false, std::memory_order_acq_rel);
+  auto const soon = soon_.exchange(false, std::memory_order_acq_rel);
+
+  if (requested || soon) {
+    auto const earliest = last_sent_ == clock::time_point{}
+                            ? now
+                            : std::max(now, last_sent_ + config_.rate_window);
+
+    next_ = std::min(next_, earliest + jitter());
+  }
+
+  if (requested) {
+    interval_ = config_.first_interval;
+    backoff_ = next_;
+  }
+
+  return next_;
+}
+
+void
+mdns::QueryScheduler::sent(clock::time_point now)
+{
+  last_sent_ = now;
+
+  // Sent ahead of the backoff for requestSoon(), the planned query still
+  // goes out when it was due
+  if (now < backoff_) {
+    next_ = std::max(backoff_, now + config_.rate_window);
+    return;
+  }
+
+  next_ = now + interval_ + jitter();
+  backoff_ = next_;
+  interval_ = std::min(interval_ * 2, config_.max_interval);
+}
+
+void
+mdns::QueryScheduler::failed(clock::time_point now)
+{
+  next_ = now + config_.rate_window + jitter();
+}
+
+std::chrono::milliseconds
+mdns::QueryScheduler::interval() const
+{
+  return interval_;
+}
+
+std::chrono::milliseconds
+mdns::QueryScheduler::jitter()
+{
+  std::uniform_int_distribution<std::chrono::milliseconds::rep> spread(
+    config_.min_jitter.count(), config_.max_jitter.count());
+  return std::chrono::milliseconds(spread(random_));
+}
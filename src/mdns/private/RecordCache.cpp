@@ -0,0 +1,384 @@
+#include "RecordCache.h"
+#include <algorithm>
+#include <string_view>
+#include <variant>
+
+namespace {
+
+constexpr auto flush_delay = std::chrono::seconds(1);
+constexpr auto no_entry =
+  std::numeric_limits<mdns::TimerWheel::timer_id>::max();
+
+std::size_t
+combine(std::size_t seed, std::size_t value)
+{
+  return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+std::size_t
+hashBytes(std::string_view bytes)
+{
+  return std::hash<std::string_view>{}(bytes);
+}
+
+// Consistent with the RDATA operator==, names compare by id
+std::size_t
+hashRdata(mdns::proto::mdns_rdata const& rdata)
+{
+  using namespace mdns::proto;
+
+  return std::visit(
+    [](auto const& ext) -> std::size_t {
+      using T = std::decay_t<decltype(ext)>;
+
+      if constexpr (std::is_same_v<T, mdns_rr_ptr_ext> ||
+                    std::is_same_v<T, mdns_rr_cname_ext>) {
+        return ext.target_id;
+      } else if constexpr (std::is_same_v<T, mdns_rr_srv_ext>) {
+        return combine(ext.target_id, ext.port);
+      } else if constexpr (std::is_same_v<T, mdns_rr_a_ext> ||
+                           std::is_same_v<T, mdns_rr_aaaa_ext>) {
+        return hashBytes(ext.address);
+      } else if constexpr (std::is_same_v<T, mdns_rr_txt_ext>) {
+        std::size_t seed = ext.entries.size();
+        for (auto const& entry : ext.entries) {
+          seed = combine(seed, hashBytes(entry));
+        }
+        return seed;
+      } else if constexpr (std::is_same_v<T, mdns_rr_unknown_ext>) {
+        auto const raw = ext.raw();
+        return hashBytes({ reinterpret_cast<char const*>(raw.data()),
+                           raw.size() });
+      } else {
+        return 0;
+      }
+    },
+    rdata);
+}
+
+}
+
+mdns::RecordCache::RecordCache()
+  : epoch_(clock::now())
+  , random_(std::random_device{}())
+{}
+
+mdns::proto::mdns_name_id
+mdns::RecordCache::ownerOf(proto::mdns_rr const& rr)
+{
+  // PTR and TXT records are published under a name the parser keeps aside
+  if (auto const* ptr = std::get_if<proto::mdns_rr_ptr_ext>(&rr.rdata);
+      ptr != nullptr && rr.type == proto::MDNS_RECORDTYPE_PTR) {
+    return ptr->owner_id;
+  }
+
+  if (auto const* txt = std::get_if<proto::mdns_rr_txt_ext>(&rr.rdata);
+      txt != nullptr && rr.type == proto::MDNS_RECORDTYPE_TXT) {
+    return txt->owner_id;
+  }
+
+  return rr.name_id;
+}
+
+std::size_t
+mdns::RecordCache::hashOf(proto::mdns_name_id owner, proto::mdns_rr const& rr)
+{
+  return combine(combine(rrsetOf(owner, rr), 0), hashRdata(rr.rdata));
+}
+
+std::uint64_t
+mdns::RecordCache::rrsetOf(proto::mdns_name_id owner, proto::mdns_rr const& rr)
+{
+  return (std::uint64_t{ owner } << 32) | (std::uint64_t{ rr.type } << 16) |
+         static_cast<std::uint16_t>(rr.clazz & ~proto::cache_flush);
+}
+
+mdns::TimerWheel::timer_id
+mdns::RecordCache::lookup(proto::mdns_name_id owner,
+                          std::size_t hash,
+                          proto::mdns_rr const& rr) const
+{
+  auto const [first, last] = index_.equal_range(hash);
+
+  for (auto it = first; it != last; ++it) {
+    auto const& cached = entries_[it->second];
+
+    if (cached.owner == owner && cached.record.type == rr.type &&
+        ((cached.record.clazz ^ rr.clazz) & ~proto::cache_flush) == 0 &&
+        cached.record.rdata == rr.rdata) {
+      return it->second;
+    }
+  }
+
+  return no_entry;
+}
+
+mdns::proto::mdns_rr const*
+mdns::RecordCache::find(proto::mdns_name_id owner, std::uint16_t type) const
+{
+  auto const key = (std::uint64_t{ owner } << 32) |
+                   (std::uint64_t{ type } << 16) | proto::MDNS_CLASS_IN;
+
+  if (auto const it = rrsets_.find(key); it != rrsets_.end()) {
+    return &entries_[it->second].record;
+  }
+
+  return nullptr;
+}
+
+void
+mdns::RecordCache::knownAnswers(proto::mdns_name_id owner,
+                                std::uint16_t type,
+                                clock::time_point now,
+                                std::vector<Known>& out) const
+{
+  auto const key = (std::uint64_t{ owner } << 32) |
+                   (std::uint64_t{ type } << 16) | proto::MDNS_CLASS_IN;
+  auto const [first, last] = rrsets_.equal_range(key);
+
+  for (auto it = first; it != last; ++it) {
+    auto const& entry = entries_[it->second];
+
+    // A goodbye or a flushed record leaves before its TTL runs out
+    auto const expires = entry.stage == expiry_stage
+                           ? entry.due
+                           : entry.received + entry.lifetime;
+    if (expires <= now || (expires - now) * 2 <= entry.lifetime) {
+      continue;
+    }
+
+    out.push_back(
+      { &entry.record,
+        static_cast<std::uint32_t>(
+          std::chrono::duration_cast<std::chrono::seconds>(expires - now)
+            .count()) });
+  }
+}
+
+void
+mdns::RecordCache::insert(proto::mdns_response const& response)
+{
+  // Known answers in the queries of others are their cache, not ours
+  if ((response.flags & proto::response_flag) == 0) {
+    return;
+  }
+
+  for (auto const& rr : response.answer_rrs) {
+    store(rr, response.time_of_arrival);
+  }
+
+  for (auto const& rr : response.additional_rrs) {
+    store(rr, response.time_of_arrival);
+  }
+}
+
+void
+mdns::RecordCache::store(proto::mdns_rr const& rr, clock::time_point received)
+{
+  auto const owner = ownerOf(rr);
+
+  if (owner == proto::invalid_name_id ||
+      rr.type == proto::MDNS_RECORDTYPE_OPT) {
+    return;
+  }
+
+  auto const hash = hashOf(owner, rr);
+  auto id = lookup(owner, hash, rr);
+
+  if (id != no_entry) {
+    auto& entry = entries_[id];
+
+    if (rr.ttl == 0) {
+      expireAt(id, received + flush_delay);
+      return;
+    }
+
+    entry.record.ttl = rr.ttl;
+    entry.received = received;
+    entry.lifetime = std::chrono::seconds(rr.ttl);
+    entry.stage = 0;
+  } else {
+    if (rr.ttl == 0 || index_.size() >= capacity) {
+      return;
+    }
+
+    if (free_.empty()) {
+      id = static_cast<TimerWheel::timer_id>(entries_.size());
+      entries_.emplace_back();
+    } else {
+      id = free_.back();
+      free_.pop_back();
+    }
+
+    auto& entry = entries_[id];
+    entry.record = rr;
+    entry.owner = owner;
+    entry.hash = hash;
+    entry.received = received;
+    entry.lifetime = std::chrono::seconds(rr.ttl);
+    entry.stage = 0;
+    entry.live = true;
+
+    // Undecoded RDATA points into a pooled receive buffer, the cache must
+    // not keep that alive
+    if (auto* raw =
+          std::get_if<proto::mdns_rr_unknown_ext>(&entry.record.rdata)) {
+      raw->detach();
+    }
+
+    index_.emplace(hash, id);
+    rrsets_.emplace(rrsetOf(owner, rr), id);
+  }
+
+  planStage(id);
+
+  if ((rr.clazz & proto::cache_flush) != 0) {
+    flushRrset(id, received);
+  }
+}
+
+void
+mdns::RecordCache::flushRrset(TimerWheel::timer_id keep,
+                              clock::time_point received)
+{
+  auto const& kept = entries_[keep];
+  auto const [first, last] =
+    rrsets_.equal_range(rrsetOf(kept.owner, kept.record));
+
+  // Records of the set received more than a second earlier are outdated by
+  // this one, the others came with it
+  for (auto it = first; it != last; ++it) {
+    auto const& entry = entries_[it->second];
+
+    if (it->second != keep && entry.received + flush_delay < received &&
+        (entry.stage != expiry_stage || entry.due > received + flush_delay)) {
+      expireAt(it->second, received + flush_delay);
+    }
+  }
+}
+
+void
+mdns::RecordCache::planStage(TimerWheel::timer_id id)
+{
+  auto& entry = entries_[id];
+
+  if (entry.stage < expiry_stage) {
+    auto const percent = 80 + 5 * entry.stage;
+    auto const spread = entry.lifetime.count() * 2 / 100;
+    std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(
+      0, spread);
+
+    entry.due = entry.received + entry.lifetime * percent / 100 +
+                std::chrono::milliseconds(jitter(random_));
+  } else {
+    entry.due = entry.received + entry.lifetime;
+  }
+
+  wheel_.schedule(id, tickAfter(entry.due));
+}
+
+void
+mdns::RecordCache::expireAt(TimerWheel::timer_id id, clock::time_point when)
+{
+  auto& entry = entries_[id];
+  entry.stage = expiry_stage;
+  entry.due = when;
+  wheel_.schedule(id, tickAfter(when));
+}
+
+void
+mdns::RecordCache::remove(TimerWheel::timer_id id)
+{
+  auto& entry = entries_[id];
+
+  auto const erase = [id](auto& map, auto key) {
+    auto const [first, last] = map.equal_range(key);
+    if (auto const it = std::find_if(
+          first, last, [id](auto const& item) { return item.second == id; });
+        it != last) {
+      map.erase(it);
+    }
+  };
+
+  erase(index_, entry.hash);
+  erase(rrsets_, rrsetOf(entry.owner, entry.record));
+  wheel_.cancel(id);
+
+  entry = Entry{};
+  free_.push_back(id);
+}
+
+void
+mdns::RecordCache::advance(clock::time_point now,
+                           std::vector<Refresh>& refresh,
+                           std::vector<proto::mdns_rr>& expired)
+{
+  auto const elapsed = now > epoch_ ? now - epoch_ : clock::duration::zero();
+
+  fired_.clear();
+  wheel_.advance(static_cast<TimerWheel::tick_t>(elapsed / tick), fired_);
+
+  for (auto const id : fired_) {
+    auto& entry = entries_[id];
+
+    if (!entry.live) {
+      continue;
+    }
+
+    // Deadlines past the wheel horizon fire early, they go around again
+    if (entry.due > now) {
+      wheel_.schedule(id, tickAfter(entry.due));
+      continue;
+    }
+
+    if (entry.stage < expiry_stage) {
+      refresh.push_back({ entry.owner, entry.record.type });
+      ++entry.stage;
+      planStage(id);
+    } else {
+      expired.push_back(std::move(entry.record));
+      remove(id);
+    }
+  }
+}
+
+mdns::RecordCache::clock::time_point
+mdns::RecordCache::nextEvent() const
+{
+  auto const next = wheel_.nextTick();
+
+  if (next == TimerWheel::never) {
+    return clock::time_point::max();
+  }
+
+  return epoch_ + tick * static_cast<std::chrono::milliseconds::rep>(next);
+}
+
+mdns::TimerWheel::tick_t
+mdns::RecordCache::tickAfter(clock::time_point when) const
+{
+  if (when <= epoch_) {
+    return 0;
+  }
+
+  // Rounded up, a record never fires before its deadline
+  return static_cast<TimerWheel::tick_t>(
+    (when - epoch_ + tick - clock::duration(1)) / tick);
+}
+
+std::size_t
+mdns::RecordCache::size() const
+{
+  return index_.size();
+}
+
+void
+mdns::RecordCache::clear()
+{
+  entries_.clear();
+  free_.clear();
+  index_.clear();
+  rrsets_.clear();
+  wheel_ = TimerWheel{};
+  epoch_ = clock::now();
+}
@@ -0,0 +1,259 @@
+#include "Resolver.h"
+#include <NameFold.h>
+#include <algorithm>
+#include <variant>
+
+namespace {
+
+// Whether target is a name directly or indirectly below owner, the shape
+// of an instance under its service type
+bool
+isBelow(std::string_view target, std::string_view owner)
+{
+  return !owner.empty() && target.size() > owner.size() + 1 &&
+         target[target.size() - owner.size() - 1] == '.' &&
+         mdns::nameEquals(target.substr(target.size() - owner.size()), owner);
+}
+
+}
+
+mdns::Resolver::Resolver(NameTable& names, RecordCache const& cache)
+  : names_(names)
+  , cache_(cache)
+  , enumeration_id_(names.intern("_services._dns-sd._udp.local"))
+{}
+
+void
+mdns::Resolver::discover(proto::mdns_response const& response)
+{
+  if ((response.flags & proto::response_flag) == 0) {
+    return;
+  }
+
+  auto const take = [&](std::pmr::vector<proto::mdns_rr> const& rrs) {
+    for (auto const& rr : rrs) {
+      auto const* ptr = std::get_if<proto::mdns_rr_ptr_ext>(&rr.rdata);
+
+      // Goodbyes are left to the cache, forget() follows its expiry
+      if (rr.type != proto::MDNS_RECORDTYPE_PTR || ptr == nullptr ||
+          rr.ttl == 0 || ptr->target_id == proto::invalid_name_id) {
+        continue;
+      }
+
+      if (ptr->owner_id == enumeration_id_) {
+        types_.insert(ptr->target_id);
+        continue;
+      }
+
+      if (auto const it = given_up_.find(ptr->target_id);
+          it != given_up_.end()) {
+        if (response.time_of_arrival < it->second) {
+          continue;
+        }
+
+        given_up_.erase(it);
+      }
+
+      if (!instances_.contains(ptr->target_id) &&
+          instances_.size() < capacity &&
+          isBelow(ptr->target, names_.lookup(ptr->owner_id))) {
+        instances_.emplace(ptr->target_id, Instance{ .ttl = rr.ttl });
+        pending_.push_back(ptr->target_id);
+      }
+    }
+  };
+
+  take(response.answer_rrs);
+  take(response.additional_rrs);
+}
+
+bool
+mdns::Resolver::advance()
+{
+  auto const holds = [&](proto::mdns_name_id name, std::uint16_t type) {
+    return cache_.find(name, type) != nullptr;
+  };
+
+  for (std::size_t i = 0; i < pending_.size();) {
+    auto& instance = instances_[pending_[i]];
+
+    if (instance.stage == Stage::Service) {
+      auto const* srv = cache_.find(pending_[i], proto::MDNS_RECORDTYPE_SRV);
+      auto const* target =
+        srv != nullptr ? std::get_if<proto::mdns_rr_srv_ext>(&srv->rdata)
+                       : nullptr;
+
+      if (target != nullptr && target->target_id != proto::invalid_name_id &&
+          holds(pending_[i], proto::MDNS_RECORDTYPE_TXT)) {
+        instance.stage = Stage::Address;
+        instance.host = target->target_id;
+        instance.attempts = 0;
+      }
+    }
+
+    if (instance.stage == Stage::Address &&
+        (holds(instance.host, proto::MDNS_RECORDTYPE_A) ||
+         holds(instance.host, proto::MDNS_RECORDTYPE_AAAA))) {
+      instance.stage = Stage::Resolved;
+      ++hosts_[instance.host];
+
+      pending_[i] = pending_.back();
+      pending_.pop_back();
+      continue;
+    }
+
+    ++i;
+  }
+
+  return rebuildQuestions();
+}
+
+void
+mdns::Resolver::forget(proto::mdns_rr const& expired)
+{
+  auto const* ptr = std::get_if<proto::mdns_rr_ptr_ext>(&expired.rdata);
+
+  if (expired.type != proto::MDNS_RECORDTYPE_PTR || ptr == nullptr) {
+    return;
+  }
+
+  if (ptr->owner_id == enumeration_id_) {
+    types_.erase(ptr->target_id);
+  } else {
+    drop(ptr->target_id);
+    given_up_.erase(ptr->target_id);
+  }
+
+  rebuildQuestions();
+}
+
+void
+mdns::Resolver::sent(clock::time_point now)
+{
+  std::erase_if(given_up_,
+                [&](auto const& entry) -> bool { return entry.second <= now; });
+
+  // A PTR record of a given up instance starts it over once the TTL it was
+  // discovered with has passed, one that keeps being announced does not
+  // keep it asking
+  for (std::size_t i = 0; i < pending_.size();) {
+    auto const id = pending_[i];
+
+    if (auto& instance = instances_[id]; ++instance.attempts >= max_attempts) {
+      if (given_up_.size() < capacity) {
+        given_up_.emplace(id, now + std::chrono::seconds(instance.ttl));
+      }
+
+      drop(id);
+    } else {
+      ++i;
+    }
+  }
+
+  rebuildQuestions();
+}
+
+void
+mdns::Resolver::drop(proto::mdns_name_id id)
+{
+  auto const it = instances_.find(id);
+  if (it == instances_.end()) {
+    return;
+  }
+
+  if (it->second.stage == Stage::Resolved) {
+    if (auto const host = hosts_.find(it->second.host);
+        host != hosts_.end() && --host->second == 0) {
+      hosts_.erase(host);
+    }
+  } else if (auto const pending = std::ranges::find(pending_, id);
+             pending != pending_.end()) {
+    *pending = pending_.back();
+    pending_.pop_back();
+  }
+
+  instances_.erase(it);
+}
+
+bool
+mdns::Resolver::rebuildQuestions()
+{
+  std::vector<Question> questions;
+
+  for (auto const type : types_) {
+    questions.push_back({ type, proto::MDNS_RECORDTYPE_PTR });
+  }
+
+  // Only what the cache still lacks is asked for
+  for (auto const id : pending_) {
+    auto const& instance = instances_[id];
+
+    if (instance.stage == Stage::Service) {
+      for (auto const type :
+           { proto::MDNS_RECORDTYPE_SRV, proto::MDNS_RECORDTYPE_TXT }) {
+        if (cache_.find(id, type) == nullptr) {
+          questions.push_back({ id, static_cast<std::uint16_t>(type) });
+        }
+      }
+    } else {
+      questions.push_back({ instance.host, proto::MDNS_RECORDTYPE_A });
+      questions.push_back({ instance.host, proto::MDNS_RECORDTYPE_AAAA });
+    }
+  }
+
+  // Hosts shared by instances are asked once
+  auto const order = [](Question const& question) {
+    return std::pair(question.name_id, question.type);
+  };
+  std::ranges::sort(questions, {}, order);
+  auto const duplicates = std::ranges::unique(questions);
+  questions.erase(duplicates.begin(), duplicates.end());
+
+  if (questions == questions_) {
+    return false;
+  }
+
+  auto const added =
+    !std::ranges::includes(questions_, questions, {}, order, order);
+  questions_ = std::move(questions);
+  ++version_;
+
+  return added;
+}
+
+void
+mdns::Resolver::clear()
+{
+  types_.clear();
+  instances_.clear();
+  pending_.clear();
+  hosts_.clear();
+  given_up_.clear();
+  questions_.clear();
+  ++version_;
+}
+
+std::uint64_t
+mdns::Resolver::version() const
+{
+  return version_;
+}
+
+std::vector<mdns::Resolver::Question> const&
+mdns::Resolver::questions() const
+{
+  return questions_;
+}
+
+bool
+mdns::Resolver::interested(proto::mdns_name_id name_id) const
+{
+  return types_.contains(name_id) || instances_.contains(name_id) ||
+         hosts_.contains(name_id);
+}
+
+std::size_t
+mdns::Resolver::pending() const
+{
+  return pending_.size();
+}
@@ -0,0 +1,167 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <utility>
+
+void
+mdns::TimerWheel::schedule(timer_id id, tick_t deadline)
+{
+  if (id >= links_.size()) {
+    links_.resize(id + 1);
+  }
+
+  if (links_[id].slot != none) {
+    unlink(id);
+  } else {
+    ++size_;
+  }
+
+  links_[id].deadline = deadline;
+  link(id, now_ + 1);
+}
+
+void
+mdns::TimerWheel::cancel(timer_id id)
+{
+  if (scheduled(id)) {
+    unlink(id);
+    --size_;
+  }
+}
+
+bool
+mdns::TimerWheel::scheduled(timer_id id) const
+{
+  return id < links_.size() && links_[id].slot != none;
+}
+
+void
+mdns::TimerWheel::link(timer_id id, tick_t earliest)
+{
+  auto& entry = links_[id];
+  auto const deadline = std::max(entry.deadline, earliest);
+  auto const delta = deadline - now_;
+
+  // The level whose slots are still finer than the distance to the deadline
+  std::size_t level = 0;
+  while (level + 1 < levels &&
+         delta >= (tick_t{ 1 } << (slot_bits * (level + 1)))) {
+    ++level;
+  }
+
+  auto const horizon = (tick_t{ 1 } << (slot_bits * levels)) - 1;
+  auto const placed = std::min(deadline, now_ + horizon);
+  auto const slot = static_cast<std::uint32_t>(
+    level * slots + ((placed >> (slot_bits * level)) & slot_mask));
+
+  entry.slot = slot;
+  entry.prev = none;
+  entry.next = heads_[slot];
+
+  if (entry.next != none) {
+    links_[entry.next].prev = id;
+  }
+
+  heads_[slot] = id;
+}
+
+void
+mdns::TimerWheel::unlink(timer_id id)
+{
+  auto& entry = links_[id];
+
+  if (entry.prev != none) {
+    links_[entry.prev].next = entry.next;
+  } else {
+    heads_[entry.slot] = entry.next;
+  }
+
+  if (entry.next != none) {
+    links_[entry.next].prev = entry.prev;
+  }
+
+  entry = Link{ .deadline = entry.deadline };
+}
+
+void
+mdns::TimerWheel::cascade(std::size_t level)
+{
+  auto const slot =
+    level * slots + ((now_ >> (slot_bits * level)) & slot_mask);
+  auto id = std::exchange(heads_[slot], none);
+
+  // Each timer lands in a lower level, those due now in the slot this tick
+  // fires next
+  while (id != none) {
+    auto const next = links_[id].next;
+    links_[id].slot = none;
+    link(id, now_);
+    id = next;
+  }
+}
+
+void
+mdns::TimerWheel::advance(tick_t tick, std::vector<timer_id>& fired)
+{
+  while (now_ < tick && size_ > 0) {
+    ++now_;
+
+    // Coarser levels first, what they hand down may land in the slot of a
+    // finer level that is cascaded in the same tick
+    for (auto level = levels - 1; level > 0; --level) {
+      if ((now_ & ((tick_t{ 1 } << (slot_bits * level)) - 1)) == 0) {
+        cascade(level);
+      }
+    }
+
+    auto const slot = static_cast<std::size_t>(now_ & slot_mask);
+    for (auto id = std::exchange(heads_[slot], none); id != none;) {
+      auto const next = links_[id].next;
+      links_[id] = Link{ .deadline = links_[id].deadline };
+      --size_;
+      fired.push_back(id);
+      id = next;
+    }
+  }
+
+  now_ = std::max(now_, tick);
+}
+
+mdns::TimerWheel::tick_t
+mdns::TimerWheel::nextTick() const
+{
+  if (size_ == 0) {
+    return never;
+  }
+
+  auto next = never;
+
+  // The first occupied slot of each level, a coarse slot only tells when it
+  // cascades, which is never after its timers are due
+  for (std::size_t level = 0; level < levels; ++level) {
+    auto const shift = slot_bits * level;
+
+    for (tick_t step = 1; step <= slots; ++step) {
+      auto const position = (now_ >> shift) + step;
+
+      if (heads_[level * slots + (position & slot_mask)] != none) {
+        next = std::min(next, position << shift);
+        break;
+      }
+    }
+  }
+
+  return next;
+}
+
+mdns::TimerWheel::tick_t
+mdns::TimerWheel::now() const
+{
+  return now_;
+}
+
+std::size_t
+mdns::TimerWheel::size() const
+{
+  return size_;
+}
@@ -4,6 +4,7 @@
 #include <imgui.h>
 #include <imgui_internal.h>
 #include <optional>
+#include <string>
 
 namespace mdns::meta {
 
@@ -15,6 +16,19 @@ public:
     std::optional<float> ui_scale_factor;
     std::optional<int> window_width;
     std::optional<int> window_height;
+    // Packet parsing threads of the browser, 0 parses on the browsing thread
+    std::optional<int> parse_threads;
+    // UDP payload bytes of a query datagram per family
+    std::optional<int> query_payload_ipv4;
+    std::optional<int> query_payload_ipv6;
+    // Packet filter of the browser, see proto::mdns_packet_filter
+    std::optional<bool> drop_queries;
+    std::optional<bool> drop_responses;
+    std::optional<bool> drop_own_queries;
+    std::optional<bool> questions_only;
+    // Comma separated IPv4 or IPv6 addresses
+    std::optional<std::string> denied_sources;
+    std::optional<int> duplicate_window_ms;
   };
 
   Settings();
@@ -1,5 +1,6 @@
 #include "Settings.h"
 #include <Logger.h>
+#include <string_view>
 
 mdns::meta::Settings::Settings()
 {
@@ -30,6 +31,43 @@ mdns::meta::Settings::Settings()
       if (std::sscanf(line, "WindowHeight=%d", &tmpI) == 1) {
         s->window_height = tmpI;
       }
+
+      if (std::sscanf(line, "ParseThreads=%d", &tmpI) == 1) {
+        s->parse_threads = tmpI;
+      }
+
+      if (std::sscanf(line, "QueryPayloadIPv4=%d", &tmpI) == 1) {
+        s->query_payload_ipv4 = tmpI;
+      }
+
+      if (std::sscanf(line, "QueryPayloadIPv6=%d", &tmpI) == 1) {
+        s->query_payload_ipv6 = tmpI;
+      }
+
+      if (std::sscanf(line, "DropQueries=%d", &tmpI) == 1) {
+        s->drop_queries = tmpI != 0;
+      }
+
+      if (std::sscanf(line, "DropResponses=%d", &tmpI) == 1) {
+        s->drop_responses = tmpI != 0;
+      }
+
+      if (std::sscanf(line, "DropOwnQueries=%d", &tmpI) == 1) {
+        s->drop_own_queries = tmpI != 0;
+      }
+
+      if (std::sscanf(line, "QuestionsOnly=%d", &tmpI) == 1) {
+        s->questions_only = tmpI != 0;
+      }
+
+      if (std::string_view const key = "DeniedSources=";
+          std::string_view(line).starts_with(key)) {
+        s->denied_sources = std::string(line + key.size());
+      }
+
+      if (std::sscanf(line, "DuplicateWindowMs=%d", &tmpI) == 1) {
+        s->duplicate_window_ms = tmpI;
+      }
     };
 
   m_handler.WriteAllFn =
@@ -43,6 +81,25 @@ mdns::meta::Settings::Settings()
                    self->m_settings.window_width.value_or(1200));
       buf->appendf("WindowHeight=%d\n",
                    self->m_settings.window_height.value_or(920));
+      buf->appendf("ParseThreads=%d\n",
+                   self->m_settings.parse_threads.value_or(0));
+      buf->appendf("QueryPayloadIPv4=%d\n",
+                   self->m_settings.query_payload_ipv4.value_or(1472));
+      buf->appendf("QueryPayloadIPv6=%d\n",
+                   self->m_settings.query_payload_ipv6.value_or(1232));
+      buf->appendf("DropQueries=%d\n",
+                   self->m_settings.drop_queries.value_or(false));
+      buf->appendf("DropResponses=%d\n",
+                   self->m_settings.drop_responses.value_or(false));
+      buf->appendf("DropOwnQueries=%d\n",
+                   self->m_settings.drop_own_queries.value_or(false));
+      buf->appendf("QuestionsOnly=%d\n",
+                   self->m_settings.questions_only.value_or(false));
+      buf->appendf(
+        "DeniedSources=%s\n",
+        self->m_settings.denied_sources.value_or(std::string()).c_str());
+      buf->appendf("DuplicateWindowMs=%d\n",
+                   self->m_settings.duplicate_window_ms.value_or(1000));
       buf->append("\n");
     };
 
@@ -0,0 +1,366 @@
+#include <Logger.h>
+#include <MdnsHelper.h>
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+// Every allocation of the process is counted, the benchmarks report the
+// difference per packet next to the timings
+namespace {
+std::atomic<std::size_t> allocations{ 0 };
+}
+
+void*
+operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+
+  throw std::bad_alloc();
+}
+
+// Kept out of line, g++ would otherwise see free() reach a pointer from
+// operator new and warn about a mismatched deallocation
+[[gnu::noinline]] void
+operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t) noexcept
+{
+  ::operator delete(ptr);
+}
+
+// std::pmr::new_delete_resource allocates through the aligned overloads
+void*
+operator new(std::size_t size, std::align_val_t alignment)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  auto const align = static_cast<std::size_t>(alignment);
+  auto const rounded = (size + align - 1) / align * align;
+#if defined(_WIN32)
+  void* ptr = _aligned_malloc(rounded == 0 ? align : rounded, align);
+#else
+  void* ptr = std::aligned_alloc(align, rounded == 0 ? align : rounded);
+#endif
+
+  if (ptr) {
+    return ptr;
+  }
+
+  throw std::bad_alloc();
+}
+
+void
+operator delete(void* ptr, std::align_val_t) noexcept
+{
+#if defined(_WIN32)
+  _aligned_free(ptr);
+#else
+  std::free(ptr);
+#endif
+}
+
+void
+operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+  operator delete(ptr, alignment);
+}
+
+namespace {
+
+// The parser keeps its name cache while decodes stay on one buffer, the
+// copies are parsed in turn so every parse starts cold like a fresh datagram
+struct CorpusPacket
+{
+  std::string name;
+  std::array<mdns::proto::mdns_packet_view, 2> copies;
+
+  [[nodiscard]] std::size_t size() const { return copies.front().size; }
+};
+
+std::vector<CorpusPacket>
+loadCorpus(std::filesystem::path const& dir)
+{
+  std::vector<CorpusPacket> corpus;
+
+  for (auto const& entry : std::filesystem::directory_iterator(dir)) {
+    if (entry.path().extension() != ".bin") {
+      continue;
+    }
+
+    std::ifstream file(entry.path(), std::ios::binary);
+    std::vector<char> const bytes{ std::istreambuf_iterator<char>(file), {} };
+    auto& packet = corpus.emplace_back();
+    packet.name = entry.path().stem().string();
+
+    for (auto& copy : packet.copies) {
+      copy = mdns::proto::mdns_packet_view::copy_of(bytes.data(), bytes.size());
+    }
+  }
+
+  std::ranges::sort(corpus, {}, &CorpusPacket::name);
+  return corpus;
+}
+
+// The receive path reuses pooled buffers, sharing the corpus buffers does
+// the same here. turn picks the copy.
+mdns::proto::mdns_recv_res
+makeMessage(CorpusPacket const& packet, std::size_t turn)
+{
+  return { { .address = { 192, 168, 1, 2 }, .port = mdns::proto::port },
+           packet.copies[turn % packet.copies.size()] };
+}
+
+// One view per copy of the packet, empty when it does not parse
+std::vector<mdns::proto::mdns_response_view>
+makeViews(mdns::MdnsHelper& helper, CorpusPacket const& packet)
+{
+  std::vector<mdns::proto::mdns_response_view> views;
+
+  for (std::size_t turn = 0; turn < packet.copies.size(); ++turn) {
+    auto view = helper.parseDiscoveryView(makeMessage(packet, turn));
+    if (!view.has_value()) {
+      return {};
+    }
+
+    views.push_back(std::move(view.value()));
+  }
+
+  return views;
+}
+
+void
+reportPerPacket(benchmark::State& state,
+                std::size_t packets,
+                std::size_t bytes,
+                std::size_t allocations_before)
+{
+  auto const total = static_cast<double>(state.iterations() * packets);
+
+  state.SetItemsProcessed(static_cast<std::int64_t>(total));
+  state.SetBytesProcessed(
+    static_cast<std::int64_t>(state.iterations() * bytes));
+  state.counters["allocs/packet"] =
+    static_cast<double>(allocations.load() - allocations_before) / total;
+}
+
+void
+BM_ParseDiscoveryResponse(benchmark::State& state, CorpusPacket const& packet)
+{
+  mdns::MdnsHelper helper;
+  std::size_t turn = 0;
+  auto const before = allocations.load();
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+      helper.parseDiscoveryResponse(makeMessage(packet, turn++)));
+  }
+
+  reportPerPacket(state, 1, packet.size(), before);
+}
+
+// The filter decides after the header and question section, rejected and
+// questions_only packets skip the RR index and decoding
+void
+BM_ParseDiscoveryBatch(benchmark::State& state,
+                       std::vector<CorpusPacket> const& corpus,
+                       mdns::proto::mdns_packet_filter const& filter)
+{
+  mdns::MdnsHelper helper;
+  mdns::proto::mdns_batch batch;
+  helper.setPacketFilter(filter);
+  std::size_t bytes = 0;
+  std::size_t turn = 0;
+
+  for (auto const& packet : corpus) {
+    bytes += packet.size();
+  }
+
+  auto const before = allocations.load();
+
+  for (auto _ : state) {
+    std::vector<mdns::proto::mdns_recv_res> messages;
+    messages.reserve(corpus.size());
+
+    for (auto const& packet : corpus) {
+      messages.push_back(makeMessage(packet, turn));
+    }
+
+    ++turn;
+
+    helper.parseDiscoveryBatch(std::move(messages), batch);
+    benchmark::DoNotOptimize(batch.responses.data());
+    batch.clear();
+  }
+
+  reportPerPacket(state, corpus.size(), bytes, before);
+}
+
+// parseName through decodeName, every question and owner name of the packet
+void
+BM_ParseName(benchmark::State& state, CorpusPacket const& packet)
+{
+  mdns::MdnsHelper helper;
+  auto const views = makeViews(helper, packet);
+  if (views.empty()) {
+    state.SkipWithError("corpus packet does not parse");
+    return;
+  }
+
+  auto const& view = views.front();
+  std::vector<std::uint16_t> offsets;
+  for (auto const& q : view.questions_list) {
+    offsets.push_back(q.name);
+  }
+
+  for (auto const* rrs :
+       { &view.answer_rrs, &view.authority_rrs, &view.additional_rrs }) {
+    for (auto const& rr : *rrs) {
+      offsets.push_back(rr.offset);
+    }
+  }
+
+  std::pmr::string name;
+  std::size_t turn = 0;
+  auto const before = allocations.load();
+
+  for (auto _ : state) {
+    auto const& packet_view = views[turn++ % views.size()].packet;
+
+    for (auto const offset : offsets) {
+      mdns::MdnsHelper::decodeName(packet_view, offset, name);
+      benchmark::DoNotOptimize(name.data());
+    }
+  }
+
+  reportPerPacket(state, 1, packet.size(), before);
+}
+
+// parseRR through decodeRR, every record of the packet
+void
+BM_ParseRR(benchmark::State& state, CorpusPacket const& packet)
+{
+  mdns::MdnsHelper helper;
+  auto const views = makeViews(helper, packet);
+  if (views.empty()) {
+    state.SkipWithError("corpus packet does not parse");
+    return;
+  }
+
+  std::size_t turn = 0;
+  auto const before = allocations.load();
+
+  for (auto _ : state) {
+    auto const& view = views[turn++ % views.size()];
+
+    for (auto const* rrs :
+         { &view.answer_rrs, &view.authority_rrs, &view.additional_rrs }) {
+      for (auto const& rr : *rrs) {
+        benchmark::DoNotOptimize(helper.decodeRR(view.packet, rr));
+      }
+    }
+  }
+
+  reportPerPacket(state, 1, packet.size(), before);
+}
+
+void
+BM_BuildQuery(benchmark::State& state)
+{
+  mdns::MdnsHelper helper;
+  std::vector<std::string> const services{
+    "_services._dns-sd._udp.local.",
+    "_airplay._tcp.local.",
+    "_googlecast._tcp.local.",
+    "_ipp._tcp.local.",
+    "Living Room._airplay._tcp.local.",
+    "HP LaserJet MFP M234sdw (3C4D5E)._ipp._tcp.local.",
+  };
+
+  std::size_t const budget = mdns::proto::mdns_payload_budget{}.ipv6;
+  std::vector<std::vector<std::uint8_t>> packets;
+  helper.buildQuery(services, budget, packets);
+  auto const before = allocations.load();
+
+  for (auto _ : state) {
+    helper.buildQuery(services, budget, packets);
+    benchmark::DoNotOptimize(packets.data());
+  }
+
+  reportPerPacket(state, 1, packets.front().size(), before);
+}
+
+}
+
+int
+main(int argc, char** argv)
+{
+  logger::init();
+  spdlog::set_level(spdlog::level::off);
+
+  static auto const corpus = loadCorpus(MDNS_CORPUS_DIR);
+
+  for (auto const& packet : corpus) {
+    benchmark::RegisterBenchmark(
+      ("BM_ParseDiscoveryResponse/" + packet.name).c_str(),
+      BM_ParseDiscoveryResponse,
+      packet);
+    benchmark::RegisterBenchmark(
+      ("BM_ParseName/" + packet.name).c_str(), BM_ParseName, packet);
+    benchmark::RegisterBenchmark(
+      ("BM_ParseRR/" + packet.name).c_str(), BM_ParseRR, packet);
+  }
+
+  // Every iteration feeds the same datagrams again, the duplicate window
+  // would drop them after the first one
+  using std::chrono_literals::operator""ms;
+
+  benchmark::RegisterBenchmark(
+    "BM_ParseDiscoveryBatch/corpus",
+    BM_ParseDiscoveryBatch,
+    corpus,
+    mdns::proto::mdns_packet_filter{ .duplicate_window = 0ms });
+  benchmark::RegisterBenchmark(
+    "BM_ParseDiscoveryBatch/questions_only",
+    BM_ParseDiscoveryBatch,
+    corpus,
+    mdns::proto::mdns_packet_filter{ .questions_only = true,
+                                     .duplicate_window = 0ms });
+  benchmark::RegisterBenchmark(
+    "BM_ParseDiscoveryBatch/drop_responses",
+    BM_ParseDiscoveryBatch,
+    corpus,
+    mdns::proto::mdns_packet_filter{ .drop_responses = true,
+                                     .duplicate_window = 0ms });
+  benchmark::RegisterBenchmark("BM_ParseDiscoveryBatch/duplicates",
+                               BM_ParseDiscoveryBatch,
+                               corpus,
+                               mdns::proto::mdns_packet_filter{});
+  benchmark::RegisterBenchmark("BM_BuildQuery", BM_BuildQuery);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include <Logger.h>
+#include <MdnsHelper.h>
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace {
+std::atomic<std::size_t> allocations{ 0 };
+}
+
+void*
+operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+
+  throw std::bad_alloc();
+}
+
+// Kept out of line, g++ would otherwise see free() reach a pointer from
+// operator new and warn about a mismatched deallocation
+[[gnu::noinline]] void
+operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t) noexcept
+{
+  ::operator delete(ptr);
+}
+
+namespace {
+
+// Printed when the fuzzer exits, e.g. after -runs=N or when replaying the
+// corpus directory
+struct Stats
+{
+  std::size_t packets = 0;
+  std::size_t allocations = 0;
+  std::chrono::nanoseconds elapsed{ 0 };
+
+  ~Stats()
+  {
+    if (packets == 0) {
+      return;
+    }
+
+    std::fprintf(stderr,
+                 "mdns_parser_fuzz: %zu packets, %.1f ns/packet, "
+                 "%.2f allocations/packet\n",
+                 packets,
+                 static_cast<double>(elapsed.count()) / packets,
+                 static_cast<double>(allocations) / packets);
+  }
+};
+
+Stats stats;
+
+std::unique_ptr<mdns::MdnsHelper> helper;
+std::unique_ptr<mdns::proto::mdns_batch> batch;
+
+// Inputs the fuzzer repeats must reach the parser every time
+std::unique_ptr<mdns::MdnsHelper>
+makeHelper()
+{
+  auto fresh = std::make_unique<mdns::MdnsHelper>();
+  fresh->setPacketFilter({ .duplicate_window = std::chrono::milliseconds(0) });
+  return fresh;
+}
+
+}
+
+extern "C" int
+LLVMFuzzerInitialize(int*, char***)
+{
+  logger::init();
+  spdlog::set_level(spdlog::level::off);
+
+  helper = makeHelper();
+  batch = std::make_unique<mdns::proto::mdns_batch>();
+  return 0;
+}
+
+extern "C" int
+LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+  std::vector<mdns::proto::mdns_recv_res> messages;
+  messages.push_back(
+    { { .address = { 192, 168, 1, 2 }, .port = mdns::proto::port },
+      mdns::proto::mdns_packet_view::copy_of(data, size) });
+
+  auto const allocations_before = allocations.load();
+  auto const start = std::chrono::steady_clock::now();
+
+  helper->parseDiscoveryBatch(std::move(messages), *batch);
+  batch->clear();
+
+  stats.elapsed += std::chrono::steady_clock::now() - start;
+  stats.allocations += allocations.load() - allocations_before;
+  stats.packets++;
+
+  return 0;
+}
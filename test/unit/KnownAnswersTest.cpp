@@ -0,0 +1,150 @@
+#include <KnownAnswers.h>
+#include <Logger.h>
+#include <MdnsHelper.h>
+#include <RecordCache.h>
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void
+check(bool condition, char const* what)
+{
+  if (!condition) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+bool
+truncated(std::vector<std::uint8_t> const& packet)
+{
+  return (((packet[2] << 8) | packet[3]) & mdns::proto::truncated_flag) != 0;
+}
+
+std::uint16_t
+answerCount(std::vector<std::uint8_t> const& packet)
+{
+  return static_cast<std::uint16_t>((packet[6] << 8) | packet[7]);
+}
+
+// Service types numbered from 1, their name ids are their numbers
+std::vector<mdns::KnownAnswers::Question>
+makeQuestions(std::size_t count)
+{
+  std::vector<mdns::KnownAnswers::Question> questions;
+
+  for (std::size_t i = 1; i <= count; ++i) {
+    questions.push_back(
+      { .name = "_service-type-number-" + std::to_string(i) + "._tcp.local",
+        .name_id = static_cast<mdns::proto::mdns_name_id>(i) });
+  }
+
+  return questions;
+}
+
+// PTR records of owner, instance ids follow the question ids
+void
+cacheInstances(mdns::RecordCache& cache,
+               mdns::KnownAnswers::Question const& owner,
+               std::size_t count,
+               mdns::RecordCache::clock::time_point now)
+{
+  mdns::proto::mdns_response response;
+  response.flags = mdns::proto::response_flag;
+  response.time_of_arrival = now;
+
+  for (std::size_t i = 0; i < count; ++i) {
+    mdns::proto::mdns_rr rr;
+    rr.type = mdns::proto::MDNS_RECORDTYPE_PTR;
+    rr.clazz = mdns::proto::MDNS_CLASS_IN;
+    rr.ttl = 4500;
+
+    mdns::proto::mdns_rr_ptr_ext ptr;
+    ptr.target = "Instance " + std::to_string(i) + "." + owner.name;
+    ptr.target_id = static_cast<mdns::proto::mdns_name_id>(1000 + i);
+    ptr.owner_id = owner.name_id;
+    rr.rdata = ptr;
+
+    response.answer_rrs.push_back(rr);
+  }
+
+  cache.insert(response);
+}
+
+// Questions alone take several datagrams, the ones before the first answer
+// are complete queries
+void
+testQuestionDatagramsStayComplete()
+{
+  auto const now = mdns::RecordCache::clock::now();
+  constexpr std::size_t budget = 512;
+
+  auto questions = makeQuestions(40);
+  std::vector<std::vector<std::uint8_t>> packets;
+  mdns::MdnsHelper::buildQuery(questions, budget, packets);
+  auto const question_packets = packets.size();
+  check(question_packets >= 3, "questions span several datagrams");
+
+  mdns::RecordCache cache;
+  cacheInstances(cache, questions.back(), 1, now);
+  mdns::KnownAnswers::append(questions, cache, now, budget, packets);
+
+  check(packets.size() == question_packets, "one answer needs no datagram");
+  check(answerCount(packets.back()) == 1, "answer in the last datagram");
+
+  for (auto const& packet : packets) {
+    check(!truncated(packet), "no TC without answers still to come");
+  }
+}
+
+// Answers that overflow the last question datagram set TC from there on
+void
+testTruncatedFromFirstAnswer()
+{
+  auto const now = mdns::RecordCache::clock::now();
+  constexpr std::size_t budget = 512;
+
+  auto questions = makeQuestions(40);
+  std::vector<std::vector<std::uint8_t>> packets;
+  mdns::MdnsHelper::buildQuery(questions, budget, packets);
+  auto const question_packets = packets.size();
+
+  mdns::RecordCache cache;
+  cacheInstances(cache, questions.back(), 40, now);
+  mdns::KnownAnswers::append(questions, cache, now, budget, packets);
+
+  check(packets.size() > question_packets, "answers continue");
+
+  for (std::size_t i = 0; i < packets.size(); ++i) {
+    auto const expected = i + 1 >= question_packets && i + 1 < packets.size();
+    check(truncated(packets[i]) == expected,
+          "TC from the first answered datagram to the last but one");
+  }
+}
+
+}
+
+int
+main()
+{
+  logger::init();
+  spdlog::set_level(spdlog::level::off);
+
+  testQuestionDatagramsStayComplete();
+  testTruncatedFromFirstAnswer();
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include <QueryScheduler.h>
+
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+using namespace std::chrono_literals;
+using clock = mdns::QueryScheduler::clock;
+
+int failures = 0;
+
+void
+check(bool condition, char const* what)
+{
+  if (!condition) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+mdns::QueryScheduler
+makeScheduler()
+{
+  return mdns::QueryScheduler(
+    { .min_jitter = std::chrono::milliseconds(0),
+      .max_jitter = std::chrono::milliseconds(0) });
+}
+
+// Sends every query as soon as it is due, until until
+clock::time_point
+runUntil(mdns::QueryScheduler& scheduler,
+         clock::time_point now,
+         clock::time_point until)
+{
+  while (scheduler.next(now) <= until) {
+    now = scheduler.next(now);
+    scheduler.sent(now);
+  }
+
+  return now;
+}
+
+// Follow-up queries go out early but the backoff keeps growing
+void
+testSoonKeepsBackoff()
+{
+  auto scheduler = makeScheduler();
+  auto const start = clock::time_point{} + 1h;
+  scheduler.restart(start);
+  auto now = runUntil(scheduler, start, start + 10s);
+
+  auto const interval = scheduler.interval();
+  auto const planned = scheduler.next(now);
+  check(interval == 16s, "backoff after the first queries");
+
+  now += 2s;
+  check(scheduler.requestSoon(), "first request wakes");
+  check(!scheduler.requestSoon(), "pending request does not wake again");
+  check(scheduler.next(now) == now, "follow-up goes out now");
+  scheduler.sent(now);
+
+  check(scheduler.interval() == interval, "follow-up keeps the interval");
+  check(scheduler.next(now) == planned, "planned query stays");
+}
+
+// A request within the rate window waits for it
+void
+testSoonRateLimited()
+{
+  auto scheduler = makeScheduler();
+  auto const start = clock::time_point{} + 1h;
+  scheduler.restart(start);
+  scheduler.sent(start);
+
+  scheduler.requestSoon();
+  check(scheduler.next(start + 200ms) == start + 1s, "rate window holds");
+}
+
+// requestNow still starts the backoff over
+void
+testNowRestartsBackoff()
+{
+  auto scheduler = makeScheduler();
+  auto const start = clock::time_point{} + 1h;
+  scheduler.restart(start);
+  auto now = runUntil(scheduler, start, start + 10s) + 2s;
+
+  scheduler.requestNow();
+  check(scheduler.next(now) == now, "requested query goes out now");
+  scheduler.sent(now);
+
+  check(scheduler.next(now) == now + 1s, "backoff starts over");
+}
+
+}
+
+int
+main()
+{
+  testSoonKeepsBackoff();
+  testSoonRateLimited();
+  testNowRestartsBackoff();
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+#include <NameTable.h>
+#include <RecordCache.h>
+#include <Resolver.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+int failures = 0;
+
+void
+check(bool condition, char const* what)
+{
+  if (!condition) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+// A response announcing instance under _http._tcp.local
+mdns::proto::mdns_response
+announce(mdns::NameTable& names,
+         std::string const& instance,
+         std::uint32_t ttl,
+         mdns::Resolver::clock::time_point when)
+{
+  mdns::proto::mdns_response response;
+  response.flags = mdns::proto::response_flag;
+  response.time_of_arrival = when;
+
+  mdns::proto::mdns_rr rr;
+  rr.type = mdns::proto::MDNS_RECORDTYPE_PTR;
+  rr.clazz = mdns::proto::MDNS_CLASS_IN;
+  rr.ttl = ttl;
+
+  mdns::proto::mdns_rr_ptr_ext ptr;
+  ptr.target = instance + "._http._tcp.local";
+  ptr.target_id = names.intern(ptr.target);
+  ptr.owner_id = names.intern("_http._tcp.local");
+  rr.rdata = ptr;
+
+  response.answer_rrs.push_back(rr);
+  return response;
+}
+
+// Gives up on an instance that never answers
+void
+giveUp(mdns::Resolver& resolver, mdns::Resolver::clock::time_point& now)
+{
+  for (std::uint8_t i = 0; i < mdns::Resolver::max_attempts; ++i) {
+    now += 1s;
+    resolver.sent(now);
+  }
+}
+
+// An instance whose PTR record keeps coming is not asked for again until
+// the TTL of that record has passed
+void
+testGivenUpWaitsForTtl()
+{
+  mdns::NameTable names;
+  mdns::RecordCache cache;
+  mdns::Resolver resolver(names, cache);
+  auto now = mdns::Resolver::clock::now();
+
+  resolver.discover(announce(names, "silent", 120, now));
+  check(resolver.advance(), "new instance asks questions");
+  check(resolver.pending() == 1, "instance pending");
+
+  giveUp(resolver, now);
+  check(resolver.pending() == 0, "instance given up");
+
+  now += 10s;
+  resolver.discover(announce(names, "silent", 120, now));
+  check(!resolver.advance(), "re-announced instance stays quiet");
+  check(resolver.pending() == 0, "instance not restarted");
+
+  now += 120s;
+  resolver.discover(announce(names, "silent", 120, now));
+  check(resolver.advance(), "instance starts over after the TTL");
+  check(resolver.pending() == 1, "instance pending again");
+}
+
+// Expiry of the PTR record ends the wait, a new record is a new instance
+void
+testExpiredPtrForgetsGivenUp()
+{
+  mdns::NameTable names;
+  mdns::RecordCache cache;
+  mdns::Resolver resolver(names, cache);
+  auto now = mdns::Resolver::clock::now();
+
+  auto const response = announce(names, "gone", 120, now);
+  resolver.discover(response);
+  resolver.advance();
+  giveUp(resolver, now);
+
+  resolver.forget(response.answer_rrs.front());
+  resolver.discover(announce(names, "gone", 120, now + 1s));
+  check(resolver.advance(), "instance back after its PTR expired");
+}
+
+}
+
+int
+main()
+{
+  testGivenUpWaitsForTtl();
+  testExpiredPtrForgetsGivenUp();
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  return 0;
+}